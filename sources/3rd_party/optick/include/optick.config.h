@@ -28,6 +28,7 @@
 // [x] OPTICK_ENABLE_TRACING		- (Enable Kernel-level tracing)
 // [x] OPTICK_ENABLE_GPU_D3D12		- (GPU D3D12)
 // [x] OPTICK_ENABLE_GPU_VULKAN		- (GPU VULKAN)
+// [x] OPTICK_ENABLE_GPU_GL			- (GPU OPENGL)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -71,3 +72,8 @@
 #endif
 #endif
 
+// OPENGL
+#if !defined(OPTICK_ENABLE_GPU_GL)
+#define OPTICK_ENABLE_GPU_GL (OPTICK_ENABLE_GPU /*&& 0*/)
+#endif
+
@@ -1361,6 +1361,15 @@ void Core::Activate(Mode::Type mode)
 
 		if (mode != Mode::OFF)
 		{
+#if OPTICK_CLEAR_FRAMES_ON_START
+			// BEGIN local patch (OPTICK_CLEAR_FRAMES_ON_START, set in sources/CMakeLists.txt, used by engine/spike_capture.cpp):
+			// frames of a capture which was stopped without a dump are dropped here, together with the thread
+			// events cleared above, so a restarted capture holds only its own frames.
+			for (int i = 0; i < FrameType::COUNT; ++i)
+				frames[i].Clear(true);
+			// END local patch
+#endif
+
 			CaptureStatus::Type status = CaptureStatus::ERR_TRACER_NOT_IMPLEMENTED;
 
 #if OPTICK_ENABLE_TRACING
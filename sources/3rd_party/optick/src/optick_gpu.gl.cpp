@@ -0,0 +1,253 @@
+// The MIT License(MIT)
+//
+// Copyright(c) 2019 Vadim Slyusarev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "optick.config.h"
+
+#if USE_OPTICK
+#if OPTICK_ENABLE_GPU_GL
+
+#include "optick_core.h"
+#include "optick_gpu.h"
+
+#if defined(_WIN32)
+	#define OPTICK_GLAPI_PTR __stdcall
+#else
+	#define OPTICK_GLAPI_PTR
+#endif
+
+// Only the handful of GL entry points used by the profiler, so Optick doesn't depend on a particular GL loader
+#define OPTICK_GL_VENDOR					0x1F00
+#define OPTICK_GL_RENDERER					0x1F01
+#define OPTICK_GL_QUERY_RESULT				0x8866
+#define OPTICK_GL_QUERY_RESULT_AVAILABLE	0x8867
+#define OPTICK_GL_TIMESTAMP					0x8E28
+
+typedef void (OPTICK_GLAPI_PTR *PFN_glGenQueries_)(int32_t n, uint32_t* ids);
+typedef void (OPTICK_GLAPI_PTR *PFN_glDeleteQueries_)(int32_t n, const uint32_t* ids);
+typedef void (OPTICK_GLAPI_PTR *PFN_glQueryCounter_)(uint32_t id, uint32_t target);
+typedef void (OPTICK_GLAPI_PTR *PFN_glGetQueryObjectiv_)(uint32_t id, uint32_t pname, int32_t* params);
+typedef void (OPTICK_GLAPI_PTR *PFN_glGetQueryObjectui64v_)(uint32_t id, uint32_t pname, uint64_t* params);
+typedef void (OPTICK_GLAPI_PTR *PFN_glGetInteger64v_)(uint32_t pname, int64_t* data);
+typedef const unsigned char* (OPTICK_GLAPI_PTR *PFN_glGetString_)(uint32_t name);
+
+namespace Optick
+{
+	class GPUProfilerGL : public GPUProfiler
+	{
+		struct GLFunctions
+		{
+			PFN_glGenQueries_ glGenQueries;
+			PFN_glDeleteQueries_ glDeleteQueries;
+			PFN_glQueryCounter_ glQueryCounter;
+			PFN_glGetQueryObjectiv_ glGetQueryObjectiv;
+			PFN_glGetQueryObjectui64v_ glGetQueryObjectui64v;
+			PFN_glGetInteger64v_ glGetInteger64v;
+			PFN_glGetString_ glGetString;
+		};
+		GLFunctions gl = {};
+
+		// GL has no query pools - a ring of individual timestamp queries plays the same role
+		vector<uint32_t> queries;
+
+		void ResolveTimestamps(uint32_t startIndex, uint32_t count);
+
+	public:
+		GPUProfilerGL();
+		~GPUProfilerGL();
+
+		bool InitDevice(GLGetProcAddress getProcAddress);
+
+		// Interface implementation
+		ClockSynchronization GetClockSynchronization(uint32_t nodeIndex) override;
+		void QueryTimestamp(void* context, int64_t* outCpuTimestamp) override;
+		void Flip(void* swapChain) override;
+	};
+
+	void InitGpuGL(GLGetProcAddress getProcAddress)
+	{
+		GPUProfilerGL* gpuProfiler = Memory::New<GPUProfilerGL>();
+		if (gpuProfiler->InitDevice(getProcAddress))
+			Core::Get().InitGPUProfiler(gpuProfiler);
+		else
+			Memory::Delete(gpuProfiler);
+	}
+
+	GPUProfilerGL::GPUProfilerGL()
+	{
+	}
+
+	bool GPUProfilerGL::InitDevice(GLGetProcAddress getProcAddress)
+	{
+		gl.glGenQueries = (PFN_glGenQueries_)getProcAddress("glGenQueries");
+		gl.glDeleteQueries = (PFN_glDeleteQueries_)getProcAddress("glDeleteQueries");
+		gl.glQueryCounter = (PFN_glQueryCounter_)getProcAddress("glQueryCounter");
+		gl.glGetQueryObjectiv = (PFN_glGetQueryObjectiv_)getProcAddress("glGetQueryObjectiv");
+		gl.glGetQueryObjectui64v = (PFN_glGetQueryObjectui64v_)getProcAddress("glGetQueryObjectui64v");
+		gl.glGetInteger64v = (PFN_glGetInteger64v_)getProcAddress("glGetInteger64v");
+		gl.glGetString = (PFN_glGetString_)getProcAddress("glGetString");
+
+		// glQueryCounter is GL 3.3 / ARB_timer_query
+		if (!gl.glGenQueries || !gl.glDeleteQueries || !gl.glQueryCounter || !gl.glGetQueryObjectiv || !gl.glGetQueryObjectui64v || !gl.glGetInteger64v || !gl.glGetString)
+			return false;
+
+		queries.resize(MAX_QUERIES_COUNT);
+		(*gl.glGenQueries)((int32_t)queries.size(), queries.data());
+
+		const char* renderer = (const char*)(*gl.glGetString)(OPTICK_GL_RENDERER);
+
+		nodes.resize(1);
+		InitNode(renderer ? renderer : "OpenGL", 0);
+		return true;
+	}
+
+	void GPUProfilerGL::QueryTimestamp(void* /*context*/, int64_t* outCpuTimestamp)
+	{
+		if (currentState == STATE_RUNNING)
+		{
+			uint32_t index = nodes[currentNode]->QueryTimestamp(outCpuTimestamp);
+			(*gl.glQueryCounter)(queries[index], OPTICK_GL_TIMESTAMP);
+		}
+	}
+
+	void GPUProfilerGL::ResolveTimestamps(uint32_t startIndex, uint32_t count)
+	{
+		if (count)
+		{
+			Node* node = nodes[currentNode];
+
+			// Frames are resolved NUM_FRAMES_DELAY flips late, so the last query is normally available already.
+			// Only stall if the driver is further behind than that, the same as WaitForFrame in the Vulkan backend.
+			int32_t available = 0;
+			(*gl.glGetQueryObjectiv)(queries[startIndex + count - 1], OPTICK_GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+			{
+				OPTICK_EVENT("WaitForFrame");
+				(*gl.glGetQueryObjectiv)(queries[startIndex + count - 1], OPTICK_GL_QUERY_RESULT, &available);
+			}
+
+			for (uint32_t index = startIndex; index < startIndex + count; ++index)
+			{
+				uint64_t timestamp = 0;
+				(*gl.glGetQueryObjectui64v)(queries[index], OPTICK_GL_QUERY_RESULT, &timestamp);
+				node->queryGpuTimestamps[index] = (int64_t)timestamp;
+			}
+
+			// Convert GPU timestamps => CPU Timestamps
+			for (uint32_t index = startIndex; index < startIndex + count; ++index)
+				*node->queryCpuTimestamps[index] = node->clock.GetCPUTimestamp(node->queryGpuTimestamps[index]);
+		}
+	}
+
+	void GPUProfilerGL::Flip(void* /*swapChain*/)
+	{
+		OPTICK_CATEGORY("GPUProfilerGL::Flip", Category::Debug);
+
+		std::lock_guard<std::recursive_mutex> lock(updateLock);
+
+		if (currentState == STATE_STARTING)
+			currentState = STATE_RUNNING;
+
+		if (currentState == STATE_RUNNING)
+		{
+			Node& node = *nodes[currentNode];
+
+			uint32_t currentFrameIndex = frameNumber % NUM_FRAMES_DELAY;
+			uint32_t nextFrameIndex = (frameNumber + 1) % NUM_FRAMES_DELAY;
+
+			QueryFrame& currentFrame = node.queryGpuframes[currentFrameIndex];
+			QueryFrame& nextFrame = node.queryGpuframes[nextFrameIndex];
+
+			if (EventData* frameEvent = currentFrame.frameEvent)
+				QueryTimestamp(nullptr, &frameEvent->finish);
+
+			// Generate GPU Frame event for the next frame
+			EventData& event = AddFrameEvent();
+			QueryTimestamp(nullptr, &event.start);
+			QueryTimestamp(nullptr, &AddFrameTag().timestamp);
+			nextFrame.frameEvent = &event;
+
+			uint32_t queryBegin = currentFrame.queryIndexStart;
+			uint32_t queryEnd = node.queryIndex;
+
+			if (queryBegin != (uint32_t)-1)
+			{
+				currentFrame.queryIndexCount = queryEnd - queryBegin;
+			}
+
+			// Preparing Next Frame
+			// Try resolve timestamps for the oldest frame in flight
+			if (nextFrame.queryIndexStart != (uint32_t)-1)
+			{
+				uint32_t startIndex = nextFrame.queryIndexStart % MAX_QUERIES_COUNT;
+				uint32_t finishIndex = (startIndex + nextFrame.queryIndexCount) % MAX_QUERIES_COUNT;
+
+				if (startIndex < finishIndex)
+				{
+					ResolveTimestamps(startIndex, finishIndex - startIndex);
+				}
+				else if (startIndex > finishIndex)
+				{
+					ResolveTimestamps(startIndex, MAX_QUERIES_COUNT - startIndex);
+					ResolveTimestamps(0, finishIndex);
+				}
+			}
+
+			nextFrame.queryIndexStart = queryEnd;
+			nextFrame.queryIndexCount = 0;
+		}
+
+		++frameNumber;
+	}
+
+	GPUProfiler::ClockSynchronization GPUProfilerGL::GetClockSynchronization(uint32_t /*nodeIndex*/)
+	{
+		GPUProfiler::ClockSynchronization clock;
+
+		// GL_TIMESTAMP via glGetInteger64v is the GPU clock "now", in nanoseconds, without going through the queue
+		clock.timestampGPU = 0;
+		(*gl.glGetInteger64v)(OPTICK_GL_TIMESTAMP, &clock.timestampGPU);
+		clock.timestampCPU = GetHighPrecisionTime();
+		clock.frequencyCPU = GetHighPrecisionFrequency();
+		clock.frequencyGPU = 1000000000ll;
+
+		return clock;
+	}
+
+	GPUProfilerGL::~GPUProfilerGL()
+	{
+		if (!queries.empty())
+			(*gl.glDeleteQueries)((int32_t)queries.size(), queries.data());
+		queries.clear();
+	}
+}
+#else
+#include "optick_common.h"
+namespace Optick
+{
+	void InitGpuGL(GLGetProcAddress /*getProcAddress*/)
+	{
+		OPTICK_FAILED("OPTICK_ENABLE_GPU_GL is disabled! Can't initialize GPU Profiler!");
+	}
+}
+#endif //OPTICK_ENABLE_GPU_GL
+#endif //USE_OPTICK
@@ -0,0 +1,270 @@
+#include "blend_tree.h"
+#include <log.h>
+#include <algorithm>
+
+int add_parameter(BlendTree &tree, const char *name, float value)
+{
+  tree.parameterNames.emplace_back(name);
+  tree.parameters.push_back(value);
+  return tree.parameters.size() - 1;
+}
+
+int find_parameter(const BlendTree &tree, const char *name)
+{
+  for (size_t i = 0; i < tree.parameterNames.size(); i++)
+    if (tree.parameterNames[i] == name)
+      return i;
+  return -1;
+}
+
+void set_parameter(BlendTree &tree, const char *name, float value)
+{
+  const int parameter = find_parameter(tree, name);
+  if (parameter < 0)
+  {
+    debug_error("blend tree parameter %s not found", name);
+    return;
+  }
+  tree.parameters[parameter] = value;
+}
+
+// Children must be added before their parent, a failed add_* returns -1 and fails the parent in turn.
+static bool valid_children(const BlendTree &tree, const std::vector<int> &children)
+{
+  for (int child : children)
+    if (child < 0 || child >= (int)tree.nodes.size())
+    {
+      debug_error("blend tree child node %d out of %d nodes", child, (int)tree.nodes.size());
+      return false;
+    }
+  return true;
+}
+
+static bool valid_parameter(const BlendTree &tree, int parameter)
+{
+  if (parameter >= -1 && parameter < (int)tree.parameters.size())
+    return true;
+  debug_error("blend tree parameter %d out of %d parameters", parameter, (int)tree.parameters.size());
+  return false;
+}
+
+static int add_node(BlendTree &tree, BlendNode &&node)
+{
+  tree.nodes.push_back(std::move(node));
+  tree.root = tree.nodes.size() - 1;
+  return tree.root;
+}
+
+int add_clip_node(BlendTree &tree, const SkeletonPtr &skeleton, AnimationPtr animation, bool additive)
+{
+  if (!animation)
+  {
+    debug_error("blend tree clip without animation");
+    return -1;
+  }
+  tree.clips.emplace_back(skeleton, animation).isAdditive = additive;
+  BlendNode node;
+  node.type = BlendNode::Type::Clip;
+  node.clip = tree.clips.size() - 1;
+  return add_node(tree, std::move(node));
+}
+
+int add_blend1d_node(BlendTree &tree, int parameter, std::vector<std::pair<int, float>> children)
+{
+  if ((int)children.size() > MaxBlendChildren)
+  {
+    debug_error("blend space with %d children, at most %d are supported", (int)children.size(), MaxBlendChildren);
+    return -1;
+  }
+  std::sort(children.begin(), children.end(), [](const auto &a, const auto &b)
+            { return a.second < b.second; });
+  BlendNode node;
+  node.type = BlendNode::Type::Blend1D;
+  node.parameterX = parameter;
+  for (const auto &[child, position] : children)
+  {
+    node.children.push_back(child);
+    node.positions.emplace_back(position, 0.f);
+  }
+  if (!valid_children(tree, node.children) || !valid_parameter(tree, parameter))
+    return -1;
+  return add_node(tree, std::move(node));
+}
+
+int add_blend2d_node(BlendTree &tree, int parameter_x, int parameter_y, const std::vector<std::pair<int, glm::vec2>> &children)
+{
+  if ((int)children.size() > MaxBlendChildren)
+  {
+    debug_error("blend space with %d children, at most %d are supported", (int)children.size(), MaxBlendChildren);
+    return -1;
+  }
+  BlendNode node;
+  node.type = BlendNode::Type::Blend2D;
+  node.parameterX = parameter_x;
+  node.parameterY = parameter_y;
+  for (const auto &[child, position] : children)
+  {
+    node.children.push_back(child);
+    node.positions.push_back(position);
+  }
+  if (!valid_children(tree, node.children) || !valid_parameter(tree, parameter_x) || !valid_parameter(tree, parameter_y))
+    return -1;
+  return add_node(tree, std::move(node));
+}
+
+int add_additive_node(BlendTree &tree, int base, int additive, int weight_parameter)
+{
+  BlendNode node;
+  node.type = BlendNode::Type::Additive;
+  node.children = {base, additive};
+  node.parameterX = weight_parameter;
+  if (!valid_children(tree, node.children) || !valid_parameter(tree, weight_parameter))
+    return -1;
+  return add_node(tree, std::move(node));
+}
+
+int add_state_machine_node(BlendTree &tree, const std::vector<int> &states)
+{
+  BlendNode node;
+  node.type = BlendNode::Type::StateMachine;
+  node.children = states;
+  if (!valid_children(tree, node.children))
+    return -1;
+  return add_node(tree, std::move(node));
+}
+
+void transition_to(BlendTree &tree, int state_machine, int state, float duration)
+{
+  if (state_machine < 0 || state_machine >= (int)tree.nodes.size())
+  {
+    debug_error("bad state machine node %d", state_machine);
+    return;
+  }
+  BlendNode &node = tree.nodes[state_machine];
+  if (node.type != BlendNode::Type::StateMachine || state < 0 || state >= (int)node.children.size())
+  {
+    debug_error("bad transition to state %d of node %d", state, state_machine);
+    return;
+  }
+  if (node.nextState >= 0)
+    node.currentState = node.nextState;
+  if (state == node.currentState)
+  {
+    node.nextState = -1;
+    return;
+  }
+  node.nextState = state;
+  node.transitionTime = 0.f;
+  node.transitionDuration = duration;
+}
+
+static float parameter_value(const BlendTree &tree, int parameter)
+{
+  return parameter >= 0 ? tree.parameters[parameter] : 0.f;
+}
+
+static void blend1d_weights(const BlendNode &node, float x, float *weights)
+{
+  const std::vector<glm::vec2> &positions = node.positions;
+  const int count = positions.size();
+  if (x <= positions[0].x)
+  {
+    weights[0] = 1.f;
+    return;
+  }
+  for (int i = 1; i < count; i++)
+    if (x < positions[i].x)
+    {
+      const float t = (x - positions[i - 1].x) / (positions[i].x - positions[i - 1].x);
+      weights[i - 1] = 1.f - t;
+      weights[i] = t;
+      return;
+    }
+  weights[count - 1] = 1.f;
+}
+
+static void blend2d_weights(const BlendNode &node, glm::vec2 p, float *weights)
+{
+  const std::vector<glm::vec2> &positions = node.positions;
+  const int count = positions.size();
+  float sum = 0.f;
+  for (int i = 0; i < count; i++)
+  {
+    float w = 1.f;
+    for (int j = 0; j < count && w > 0.f; j++)
+    {
+      if (i == j)
+        continue;
+      const glm::vec2 edge = positions[j] - positions[i];
+      const float length2 = glm::dot(edge, edge);
+      if (length2 > 0.f)
+        w = std::min(w, 1.f - glm::dot(p - positions[i], edge) / length2);
+    }
+    weights[i] = std::max(w, 0.f);
+    sum += weights[i];
+  }
+  if (sum > 0.f)
+    for (int i = 0; i < count; i++)
+      weights[i] /= sum;
+}
+
+static void accumulate_weights(BlendTree &tree, int index, float weight)
+{
+  // whole subtrees without weight are skipped, their clips stay at zero
+  if (weight <= 0.f)
+    return;
+  const BlendNode &node = tree.nodes[index];
+  switch (node.type)
+  {
+  case BlendNode::Type::Clip:
+    tree.clips[node.clip].weight += weight;
+    break;
+  case BlendNode::Type::Blend1D:
+  case BlendNode::Type::Blend2D:
+  {
+    if (node.children.empty())
+      break;
+    float weights[MaxBlendChildren] = {};
+    if (node.type == BlendNode::Type::Blend1D)
+      blend1d_weights(node, parameter_value(tree, node.parameterX), weights);
+    else
+      blend2d_weights(node, glm::vec2(parameter_value(tree, node.parameterX), parameter_value(tree, node.parameterY)), weights);
+    for (size_t i = 0; i < node.children.size(); i++)
+      accumulate_weights(tree, node.children[i], weight * weights[i]);
+    break;
+  }
+  case BlendNode::Type::Additive:
+    accumulate_weights(tree, node.children[0], weight);
+    accumulate_weights(tree, node.children[1], weight * glm::clamp(parameter_value(tree, node.parameterX), 0.f, 1.f));
+    break;
+  case BlendNode::Type::StateMachine:
+  {
+    if (node.children.empty())
+      break;
+    const float t = node.nextState >= 0 ? glm::clamp(node.transitionTime / node.transitionDuration, 0.f, 1.f) : 0.f;
+    accumulate_weights(tree, node.children[node.currentState], weight * (1.f - t));
+    if (node.nextState >= 0)
+      accumulate_weights(tree, node.children[node.nextState], weight * t);
+    break;
+  }
+  }
+}
+
+void evaluate_blend_tree(BlendTree &tree, float dt)
+{
+  for (BlendNode &node : tree.nodes)
+  {
+    if (node.type != BlendNode::Type::StateMachine || node.nextState < 0)
+      continue;
+    node.transitionTime += dt;
+    if (node.transitionTime >= node.transitionDuration)
+    {
+      node.currentState = node.nextState;
+      node.nextState = -1;
+    }
+  }
+  for (AnimationLayer &clip : tree.clips)
+    clip.weight = 0.f;
+  if (tree.root >= 0)
+    accumulate_weights(tree, tree.root, 1.f);
+}
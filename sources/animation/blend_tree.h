@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "character.h"
+
+// Blend spaces hold at most this many children, their weights are resolved on the stack.
+constexpr int MaxBlendChildren = 16;
+
+// Node of a blend tree. Clips are the leaves, the other nodes only split the weight they receive between children.
+struct BlendNode
+{
+  enum class Type
+  {
+    Clip,
+    Blend1D,
+    Blend2D,
+    Additive,
+    StateMachine
+  };
+  Type type = Type::Clip;
+
+  // Clip: index into BlendTree::clips
+  int clip = -1;
+
+  // Blend1D, Blend2D and StateMachine children, Additive holds the base and then the additive child
+  std::vector<int> children;
+
+  // Blend space sample positions, one per child, Blend1D uses only x and keeps them sorted
+  std::vector<glm::vec2> positions;
+
+  // Blend1D and Blend2D coordinates, Additive takes its weight from parameterX
+  int parameterX = -1;
+  int parameterY = -1;
+
+  // StateMachine, nextState is -1 when no transition runs
+  int currentState = 0;
+  int nextState = -1;
+  float transitionTime = 0.f;
+  float transitionDuration = 0.f;
+};
+
+// Blend spaces, additive nodes and state machines over a set of clips. Weights are resolved down to the clips
+// before anything is sampled, so update_character samples only the few clips which contribute to the pose.
+struct BlendTree
+{
+  std::vector<BlendNode> nodes;
+  std::vector<AnimationLayer> clips;
+  std::vector<std::string> parameterNames;
+  std::vector<float> parameters;
+  // the node added last unless set otherwise, trees are built bottom up
+  int root = -1;
+};
+
+int add_parameter(BlendTree &tree, const char *name, float value = 0.f);
+int find_parameter(const BlendTree &tree, const char *name);
+void set_parameter(BlendTree &tree, const char *name, float value);
+
+// Every add_* returns the new node or -1 when a child or parameter index is invalid, nothing is added then.
+// Children are added first, so a failed child makes its parent fail too.
+int add_clip_node(BlendTree &tree, const SkeletonPtr &skeleton, AnimationPtr animation, bool additive = false);
+// children are (node, position) pairs
+int add_blend1d_node(BlendTree &tree, int parameter, std::vector<std::pair<int, float>> children);
+// Gradient band interpolation, every child keeps full weight at its own position.
+int add_blend2d_node(BlendTree &tree, int parameter_x, int parameter_y, const std::vector<std::pair<int, glm::vec2>> &children);
+int add_additive_node(BlendTree &tree, int base, int additive, int weight_parameter);
+int add_state_machine_node(BlendTree &tree, const std::vector<int> &states);
+
+// Cross fades the state machine node to state over duration seconds. A transition started during another one
+// finishes the running one first.
+void transition_to(BlendTree &tree, int state_machine, int state, float duration);
+
+// Advances transitions by dt and writes the effective weight of every clip to its AnimationLayer::weight.
+// Clip times are advanced by update_character, contributing or not.
+void evaluate_blend_tree(BlendTree &tree, float dt);
@@ -0,0 +1,298 @@
+#include "character.h"
+#include "blend_tree.h"
+#include <log.h>
+#include <counters.h>
+#include <probes.h>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+
+#include "ozz/animation/runtime/local_to_model_job.h"
+#include "ozz/animation/runtime/skeleton.h"
+#include "ozz/animation/runtime/blending_job.h"
+#include "ozz/animation/runtime/skeleton_utils.h"
+
+void set_layer_mask(AnimationLayer &layer, const Skeleton &skeleton, int root_joint, bool include)
+{
+  layer.maskRoot = root_joint;
+  layer.maskInclude = include;
+  layer.jointWeights.clear();
+  if (root_joint < 0)
+    return;
+
+  const auto parents = skeleton.skeleton->joint_parents();
+  const int numJoints = skeleton.skeleton->num_joints();
+  std::vector<float> weights(skeleton.skeleton->num_soa_joints() * 4, 0.f);
+  std::vector<bool> inSubtree(numJoints, false);
+  for (int i = 0; i < numJoints; i++)
+  {
+    // parents come before their children
+    inSubtree[i] = i == root_joint || (parents[i] >= 0 && inSubtree[parents[i]]);
+    weights[i] = inSubtree[i] == include ? 1.f : 0.f;
+  }
+  layer.jointWeights.resize(skeleton.skeleton->num_soa_joints());
+  for (size_t i = 0; i < layer.jointWeights.size(); i++)
+    layer.jointWeights[i] = ozz::math::simd_float4::LoadPtrU(&weights[i * 4]);
+}
+
+void set_layer_mask(AnimationLayer &layer, const Skeleton &skeleton, const char *root_joint, bool include)
+{
+  const int joint = ozz::animation::FindJoint(*skeleton.skeleton, root_joint);
+  if (joint < 0)
+    debug_error("layer mask joint %s not found", root_joint);
+  set_layer_mask(layer, skeleton, joint, include);
+}
+
+// Samples the layers which contribute and blends them into locals_, the others only advance their playback time.
+static void blend_layers(Character &character, std::vector<AnimationLayer> &animation_layers, float dt)
+{
+  std::vector<ozz::animation::BlendingJob::Layer> &layers = character.blendLayers, &additive = character.blendAdditive;
+  layers.clear();
+  additive.clear();
+  for (AnimationLayer &animation_layer : animation_layers)
+  {
+    animation_layer.controller.Update(animation_layer.animation, dt);
+    if (animation_layer.weight < MinLayerWeight)
+      continue;
+
+    // Samples optimized animation at t = animation_time_.
+    ozz::animation::SamplingJob sampling_job;
+    sampling_job.animation = animation_layer.animation.get();
+    sampling_job.context = animation_layer.context.get();
+    sampling_job.ratio = animation_layer.controller.time_ratio_;
+    sampling_job.output = ozz::make_span(animation_layer.locals);
+    if (!sampling_job.Run())
+    {
+      debug_error("sampling_job failed");
+      continue;
+    }
+    add_counter(FrameCounter::JointsSampled, character.skeleton_->skeleton->num_joints());
+
+    ozz::animation::BlendingJob::Layer layer;
+    layer.transform = ozz::make_span(animation_layer.locals);
+    layer.weight = animation_layer.weight;
+    layer.joint_weights = ozz::make_span(animation_layer.jointWeights);
+    if (!animation_layer.isAdditive)
+      layers.push_back(layer);
+    else
+      additive.push_back(layer);
+  }
+
+  // Setups blending job.
+  ozz::animation::BlendingJob blend_job;
+  blend_job.threshold = 0.1;
+  blend_job.layers = ozz::make_span(layers);
+  blend_job.additive_layers = ozz::make_span(additive);
+  blend_job.rest_pose = character.skeleton_->skeleton->joint_rest_poses();
+  blend_job.output = ozz::make_span(character.locals_);
+
+  // Blends.
+  if (!blend_job.Run())
+  {
+    debug_error("blend_job failed");
+    return;
+  }
+  add_counter(FrameCounter::LayersBlended, layers.size() + additive.size());
+}
+
+static void update_character_pose(Character &character, float dt)
+{
+  if (character.blendTree)
+  {
+    evaluate_blend_tree(*character.blendTree, dt);
+    blend_layers(character, character.blendTree->clips, dt);
+  }
+  else if (!character.layers.empty())
+  {
+    blend_layers(character, character.layers, dt);
+  }
+  else if (character.currentAnimation)
+  {
+    character.controller.Update(character.currentAnimation, dt);
+
+    // Samples optimized animation at t = animation_time_.
+    ozz::animation::SamplingJob sampling_job;
+    sampling_job.animation = character.currentAnimation.get();
+    sampling_job.context = character.context_.get();
+    sampling_job.ratio = character.controller.time_ratio_;
+    sampling_job.output = ozz::make_span(character.locals_);
+    if (!sampling_job.Run())
+    {
+      return;
+    }
+    add_counter(FrameCounter::JointsSampled, character.skeleton_->skeleton->num_joints());
+  }
+  else
+  {
+    auto restPose = character.skeleton_->skeleton->joint_rest_poses();
+    std::copy(restPose.begin(), restPose.end(), character.locals_.begin());
+  }
+  if (character.skeletonLod > 0 && character.skeletonLod < (int)character.skeletonLods.size())
+  {
+    if (!local_to_model_lod(*character.skeleton_, character.skeletonLods[character.skeletonLod], character.locals_, character.models_))
+      debug_error("ltm_job failed for skeleton lod %d", character.skeletonLod);
+    return;
+  }
+  ozz::animation::LocalToModelJob ltm_job;
+  ltm_job.skeleton = character.skeleton_->skeleton.get();
+  ltm_job.input = ozz::make_span(character.locals_);
+  ltm_job.output = ozz::make_span(character.models_);
+  if (!ltm_job.Run())
+  {
+    return;
+  }
+}
+
+void update_character(Character &character, float dt)
+{
+  const int numJoints = character.skeleton_->skeleton->num_joints();
+  PROBE2(update_character_entry, numJoints, character.layers.size());
+  update_character_pose(character, dt);
+  PROBE1(update_character_return, numJoints);
+}
+
+void simulate_character(Character &character, float step)
+{
+  character.prevModels_.assign(character.models_.begin(), character.models_.end());
+  update_character(character, step);
+  // the previous pose is from before the character was culled, interpolating from it would pop
+  if (character.poseStale)
+  {
+    character.prevModels_.assign(character.models_.begin(), character.models_.end());
+    character.poseStale = false;
+  }
+}
+
+void advance_character_time(Character &character, float step)
+{
+  character.poseStale = true;
+  if (character.blendTree)
+  {
+    evaluate_blend_tree(*character.blendTree, step);
+    for (AnimationLayer &clip : character.blendTree->clips)
+      clip.controller.Update(clip.animation, step);
+  }
+  else if (!character.layers.empty())
+  {
+    for (AnimationLayer &layer : character.layers)
+      layer.controller.Update(layer.animation, step);
+  }
+  else if (character.currentAnimation)
+  {
+    character.controller.Update(character.currentAnimation, step);
+  }
+}
+
+void refresh_stale_pose(Character &character, float alpha)
+{
+  if (!character.poseStale)
+    return;
+  update_character(character, 0.f);
+  character.prevModels_.assign(character.models_.begin(), character.models_.end());
+  character.poseStale = false;
+  interpolate_character(character, alpha);
+  update_character_bounds(character);
+}
+
+void interpolate_character(Character &character, float alpha)
+{
+  const size_t nodeCount = character.models_.size();
+  character.renderModels_.resize(nodeCount);
+  if (character.prevModels_.size() != nodeCount)
+  {
+    std::copy(character.models_.begin(), character.models_.end(), character.renderModels_.begin());
+    return;
+  }
+  // States are a single step apart, so a per column blend stays close to a rigid transform.
+  const ozz::math::SimdFloat4 t = ozz::math::simd_float4::Load1(alpha);
+  for (size_t i = 0; i < nodeCount; i++)
+  {
+    const ozz::math::Float4x4 &a = character.prevModels_[i];
+    const ozz::math::Float4x4 &b = character.models_[i];
+    ozz::math::Float4x4 &result = character.renderModels_[i];
+    for (int c = 0; c < 4; c++)
+      result.cols[c] = ozz::math::Lerp(a.cols[c], b.cols[c], t);
+  }
+}
+
+void build_palette(const std::vector<ozz::math::Float4x4> &models, const std::vector<ozz::math::Float4x4> &inv_bind_pose,
+                   std::vector<ozz::math::Float4x4> &palette)
+{
+  size_t nodeCount = models.size();
+  palette.resize(nodeCount);
+  for (size_t i = 0; i < nodeCount; i++)
+  {
+    palette[i] = models[i] * inv_bind_pose[i];
+  }
+}
+
+void init_character_bounds(Character &character)
+{
+  character.jointBounds.assign(character.skeleton_->skeleton->num_joints(), BoneBounds());
+  for (const MeshPtr &mesh : character.meshes)
+    for (size_t i = 0; i < mesh->boneBounds.size() && i < character.jointBounds.size(); i++)
+    {
+      BoneBounds &bounds = character.jointBounds[i];
+      bounds.boxMin = glm::min(bounds.boxMin, mesh->boneBounds[i].boxMin);
+      bounds.boxMax = glm::max(bounds.boxMax, mesh->boneBounds[i].boxMax);
+    }
+
+  // torso joints, their skin is thick enough around the bone to occlude
+  character.occluderJoints.clear();
+  const auto names = character.skeleton_->skeleton->joint_names();
+  for (size_t i = 0; i < character.jointBounds.size(); i++)
+  {
+    std::string name = names[i];
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    const bool torso = name.find("spine") != std::string::npos || name.find("hips") != std::string::npos ||
+                       name.find("pelvis") != std::string::npos || name.find("chest") != std::string::npos;
+    if (torso && !character.jointBounds[i].empty())
+      character.occluderJoints.push_back(i);
+  }
+}
+
+void update_character_bounds(Character &character)
+{
+  const std::vector<ozz::math::Float4x4> &models = character.renderModels_;
+  const std::vector<BoneBounds> &jointBounds = character.jointBounds;
+  const size_t nodeCount = std::min(models.size(), jointBounds.size());
+
+  const ozz::math::SimdFloat4 half = ozz::math::simd_float4::Load1(0.5f);
+  ozz::math::SimdFloat4 boxMin = ozz::math::simd_float4::Load1(FLT_MAX);
+  ozz::math::SimdFloat4 boxMax = ozz::math::simd_float4::Load1(-FLT_MAX);
+  for (size_t i = 0; i < nodeCount; i++)
+  {
+    const BoneBounds &bone = jointBounds[i];
+    if (bone.empty())
+      continue;
+    // center and extent form, the extent of a rotated box is the abs matrix applied to it
+    const ozz::math::Float4x4 &tm = models[i];
+    const ozz::math::SimdFloat4 lo = ozz::math::simd_float4::Load(bone.boxMin.x, bone.boxMin.y, bone.boxMin.z, 1.f);
+    const ozz::math::SimdFloat4 hi = ozz::math::simd_float4::Load(bone.boxMax.x, bone.boxMax.y, bone.boxMax.z, 1.f);
+    const ozz::math::SimdFloat4 center = ozz::math::TransformPoint(tm, (lo + hi) * half);
+    const ozz::math::SimdFloat4 size = (hi - lo) * half;
+    const ozz::math::SimdFloat4 extent =
+        ozz::math::Abs(tm.cols[0]) * ozz::math::simd_float4::Load1(ozz::math::GetX(size)) +
+        ozz::math::Abs(tm.cols[1]) * ozz::math::simd_float4::Load1(ozz::math::GetY(size)) +
+        ozz::math::Abs(tm.cols[2]) * ozz::math::simd_float4::Load1(ozz::math::GetZ(size));
+    boxMin = ozz::math::Min(boxMin, center - extent);
+    boxMax = ozz::math::Max(boxMax, center + extent);
+  }
+  if (ozz::math::GetX(boxMin) > ozz::math::GetX(boxMax))
+  {
+    // no skinned joints, never culled
+    character.boundsMin = character.boundsMax = glm::vec3(character.transform[3]);
+    character.bounds = glm::vec4(glm::vec3(character.transform[3]), FLT_MAX);
+    return;
+  }
+
+  const glm::vec3 localMin(ozz::math::GetX(boxMin), ozz::math::GetY(boxMin), ozz::math::GetZ(boxMin));
+  const glm::vec3 localMax(ozz::math::GetX(boxMax), ozz::math::GetY(boxMax), ozz::math::GetZ(boxMax));
+  const glm::mat4 &tm = character.transform;
+  const glm::vec3 center = glm::vec3(tm * glm::vec4((localMin + localMax) * 0.5f, 1.f));
+  const glm::vec3 size = (localMax - localMin) * 0.5f;
+  const glm::vec3 extent = glm::abs(glm::vec3(tm[0])) * size.x + glm::abs(glm::vec3(tm[1])) * size.y + glm::abs(glm::vec3(tm[2])) * size.z;
+  character.boundsMin = center - extent;
+  character.boundsMax = center + extent;
+  character.bounds = glm::vec4(center, glm::length(extent));
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include <render/scene.h>
+#include <render/material.h>
+#include <render/global_uniform.h>
+#include "skeleton_lod.h"
+
+#include "ozz/animation/runtime/animation.h"
+#include "ozz/animation/runtime/blending_job.h"
+#include "ozz/animation/runtime/sampling_job.h"
+#include "ozz/animation/runtime/skeleton.h"
+#include "ozz/base/maths/simd_math.h"
+#include "ozz/base/maths/soa_transform.h"
+
+struct PlaybackController
+{
+public:
+  // Updates animation time if in "play" state, according to playback speed and
+  // given frame time _dt.
+  // Returns true if animation has looped during update
+  void Update(const AnimationPtr &_animation, float _dt)
+  {
+    float new_time = time_ratio_;
+
+    if (play_)
+    {
+      new_time = time_ratio_ + _dt * playback_speed_ / _animation->duration();
+    }
+    if (loop_)
+    {
+      // Wraps in the unit interval [0:1], even for negative values (the reason
+      // for using floorf).
+      time_ratio_ = new_time - floorf(new_time);
+    }
+    else
+    {
+      // Clamps in the unit interval [0:1].
+      time_ratio_ = new_time;
+    }
+  }
+
+  void Reset()
+  {
+    time_ratio_ = 0.f;
+    playback_speed_ = 1.f;
+    play_ = true;
+    loop_ = true;
+  }
+
+  // Current animation time ratio, in the unit interval [0,1], where 0 is the
+  // beginning of the animation, 1 is the end.
+  float time_ratio_;
+
+  // Playback speed, can be negative in order to play the animation backward.
+  float playback_speed_;
+
+  // Animation play mode state: play/pause.
+  bool play_;
+
+  // Animation loop mode.
+  bool loop_;
+};
+
+// Layers below this weight are not sampled, only their playback time advances.
+constexpr float MinLayerWeight = 1e-3f;
+
+struct AnimationLayer
+{
+  // Constructor, default initialization.
+  AnimationLayer(const SkeletonPtr &skeleton, AnimationPtr animation) : weight(1.f), animation(animation)
+  {
+    controller.Reset();
+
+    locals.resize(skeleton->skeleton->num_soa_joints());
+
+    // Allocates a context that matches animation requirements.
+    context = std::make_shared<ozz::animation::SamplingJob::Context>(skeleton->skeleton->num_joints());
+  }
+
+  bool isAdditive = false;
+  // Playback animation controller. This is a utility class that helps with
+  // controlling animation playback time.
+  PlaybackController controller;
+
+  // Blending weight for the layer.
+  float weight;
+
+  // Runtime animation.
+  AnimationPtr animation;
+
+  // Sampling context.
+  std::shared_ptr<ozz::animation::SamplingJob::Context> context;
+
+  // Buffer of local transforms as sampled from animation_.
+  std::vector<ozz::math::SoaTransform> locals;
+
+  // Per joint blending weights in SoA layout, empty when the layer drives the whole body.
+  std::vector<ozz::math::SimdFloat4> jointWeights;
+
+  // Mask as authored, the subtree of maskRoot is included or excluded, -1 for no mask.
+  int maskRoot = -1;
+  bool maskInclude = true;
+};
+
+// Limits the layer to the subtree of root_joint, or to everything but it when include is false.
+// A negative root_joint removes the mask.
+void set_layer_mask(AnimationLayer &layer, const Skeleton &skeleton, int root_joint, bool include);
+void set_layer_mask(AnimationLayer &layer, const Skeleton &skeleton, const char *root_joint, bool include);
+
+struct BlendTree;
+
+struct Character
+{
+  glm::mat4 transform;
+  std::vector<MeshPtr> meshes;
+  MaterialPtr material;
+  GPUBuffer skeletonBuffer;
+
+  // Runtime skeleton.
+  SkeletonPtr skeleton_;
+
+  // Sampling context.
+  std::shared_ptr<ozz::animation::SamplingJob::Context> context_;
+
+  // Buffer of local transforms as sampled from animation_.
+  std::vector<ozz::math::SoaTransform> locals_;
+
+  // Buffer of model space matrices.
+  std::vector<ozz::math::Float4x4> models_;
+
+  // Model space matrices of the previous simulation step.
+  std::vector<ozz::math::Float4x4> prevModels_;
+
+  // Pose between prevModels_ and models_ which is rendered this frame.
+  std::vector<ozz::math::Float4x4> renderModels_;
+
+  // Skinning matrices of one mesh, rebuilt for every mesh when rendering.
+  std::vector<ozz::math::Float4x4> palette;
+
+  std::vector<AnimationLayer> layers;
+
+  // Drives the pose instead of layers when set.
+  std::shared_ptr<BlendTree> blendTree;
+
+  // BlendingJob inputs, kept between updates so blending does not allocate.
+  std::vector<ozz::animation::BlendingJob::Layer> blendLayers, blendAdditive;
+
+  AnimationPtr currentAnimation;
+  PlaybackController controller;
+
+  // Per joint skin box, the union over meshes.
+  std::vector<BoneBounds> jointBounds;
+
+  // Torso joints with skin, their shrunk bone space boxes are the occluders of the character.
+  std::vector<int> occluderJoints;
+
+  // World space box of the skin in the renderModels_ pose.
+  glm::vec3 boundsMin = glm::vec3(0.f);
+  glm::vec3 boundsMax = glm::vec3(0.f);
+
+  // Sphere around the same box, xyz center and w radius.
+  glm::vec4 bounds = glm::vec4(0.f);
+
+  // Result of the last frustum test, invisible characters only advance their playback time.
+  bool visible = true;
+
+  // models_ is older than the playback time, set by advance_character_time until the next simulation step.
+  bool poseStale = false;
+
+  // Mesh level of detail picked by projected size.
+  int lod = 0;
+
+  // Truncated joint sets, skeletonLods[0] is the full skeleton.
+  std::vector<SkeletonLod> skeletonLods;
+  int skeletonLod = 0;
+};
+
+// Samples, blends and converts the character pose to model space.
+void update_character(Character &character, float dt);
+
+// Runs one fixed simulation step, the pose before it moves to prevModels_ and the new one is written to models_.
+void simulate_character(Character &character, float step);
+
+// Advances playback time without sampling, for characters which are not rendered.
+void advance_character_time(Character &character, float step);
+
+// Samples the pose of a character which was culled at its current playback time, without interpolating from the
+// old pose, and updates renderModels_ and the bounds. Does nothing unless poseStale.
+void refresh_stale_pose(Character &character, float alpha);
+
+// Blends prevModels_ and models_ into renderModels_ by the accumulated step fraction alpha,
+// so rendering lags the simulation by at most one step.
+void interpolate_character(Character &character, float alpha);
+
+// Skinning matrices for the mesh in the current model space pose.
+void build_palette(const std::vector<ozz::math::Float4x4> &models, const std::vector<ozz::math::Float4x4> &inv_bind_pose,
+                   std::vector<ozz::math::Float4x4> &palette);
+
+// Collects Character::jointBounds from the meshes and picks the occluder joints.
+void init_character_bounds(Character &character);
+
+// Transforms the joint boxes by renderModels_ and moves their union to world space with the character transform.
+void update_character_bounds(Character &character);
@@ -0,0 +1,531 @@
+#include "motion_matching.h"
+#include <log.h>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <climits>
+#include <fstream>
+
+#include "ozz/animation/runtime/animation.h"
+#include "ozz/animation/runtime/local_to_model_job.h"
+#include "ozz/animation/runtime/sampling_job.h"
+#include "ozz/animation/runtime/skeleton.h"
+#include "ozz/base/maths/simd_math.h"
+#include "ozz/base/maths/soa_transform.h"
+
+// padding slots sit far away from any normalized query
+static const float PaddingFeature = 1e18f;
+
+static bool name_contains(std::string name, std::initializer_list<const char *> patterns)
+{
+  std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c)
+                 { return std::tolower(c); });
+  for (const char *pattern : patterns)
+    if (name.find(pattern) != std::string::npos)
+      return true;
+  return false;
+}
+
+bool find_motion_joints(const Skeleton &skeleton, MotionJoints &joints)
+{
+  const auto names = skeleton.skeleton->joint_names();
+  joints = MotionJoints();
+  // the first match is the highest in the hierarchy, children like LeftFootEnd come later
+  for (int i = 0; i < (int)names.size(); i++)
+  {
+    if (joints.hips < 0 && name_contains(names[i], {"hips", "pelvis"}))
+      joints.hips = i;
+    if (joints.leftFoot < 0 && name_contains(names[i], {"leftfoot", "left_foot", "foot_l", "foot.l"}))
+      joints.leftFoot = i;
+    if (joints.rightFoot < 0 && name_contains(names[i], {"rightfoot", "right_foot", "foot_r", "foot.r"}))
+      joints.rightFoot = i;
+  }
+  if (joints.hips < 0 || joints.leftFoot < 0 || joints.rightFoot < 0)
+  {
+    debug_error("motion matching joints not found, hips %d left foot %d right foot %d", joints.hips, joints.leftFoot, joints.rightFoot);
+    return false;
+  }
+  return true;
+}
+
+// Joint positions of one clip at the database sample rate.
+struct ClipSamples
+{
+  std::vector<glm::vec3> hips, leftFoot, rightFoot;
+  std::vector<glm::vec2> facing; // xz
+  int count() const { return hips.size(); }
+};
+
+static glm::vec3 joint_position(const ozz::math::Float4x4 &model)
+{
+  glm::vec3 position;
+  ozz::math::Store3PtrU(model.cols[3], &position.x);
+  return position;
+}
+
+static bool sample_clip(const Skeleton &skeleton, const MotionJoints &joints, const ozz::animation::Animation &animation, float sample_rate,
+                        ozz::animation::SamplingJob::Context &context, ClipSamples &samples)
+{
+  const ozz::animation::Skeleton &ozzSkeleton = *skeleton.skeleton;
+  std::vector<ozz::math::SoaTransform> locals(ozzSkeleton.num_soa_joints());
+  std::vector<ozz::math::Float4x4> models(ozzSkeleton.num_joints());
+  const float duration = animation.duration();
+  const int count = int(duration * sample_rate) + 1;
+  for (int i = 0; i < count; i++)
+  {
+    ozz::animation::SamplingJob sampling_job;
+    sampling_job.animation = &animation;
+    sampling_job.context = &context;
+    sampling_job.ratio = duration > 0.f ? std::min(i / sample_rate / duration, 1.f) : 0.f;
+    sampling_job.output = ozz::make_span(locals);
+    ozz::animation::LocalToModelJob ltm_job;
+    ltm_job.skeleton = &ozzSkeleton;
+    ltm_job.input = ozz::make_span(locals);
+    ltm_job.output = ozz::make_span(models);
+    if (!sampling_job.Run() || !ltm_job.Run())
+      return false;
+
+    samples.hips.push_back(joint_position(models[joints.hips]));
+    samples.leftFoot.push_back(joint_position(models[joints.leftFoot]));
+    samples.rightFoot.push_back(joint_position(models[joints.rightFoot]));
+    glm::vec3 forward;
+    ozz::math::Store3PtrU(models[joints.hips].cols[2], &forward.x);
+    glm::vec2 facing(forward.x, forward.z);
+    samples.facing.push_back(glm::length(facing) > 1e-5f ? glm::normalize(facing) : glm::vec2(0.f, 1.f));
+  }
+  return true;
+}
+
+// Frames past the end continue with the last frame velocity.
+template<typename T>
+static T extrapolate(const std::vector<T> &values, int i)
+{
+  const int last = values.size() - 1;
+  if (i <= last)
+    return values[i];
+  if (last == 0)
+    return values[0];
+  return values[last] + (values[last] - values[last - 1]) * float(i - last);
+}
+
+static void extract_features(const ClipSamples &samples, int i, const MotionFeatureSettings &settings, float *feature)
+{
+  const glm::vec2 facing = samples.facing[i];
+  const glm::vec2 right(facing.y, -facing.x);
+  const glm::vec2 root(samples.hips[i].x, samples.hips[i].z);
+  auto local2 = [&](glm::vec2 v)
+  { return glm::vec2(glm::dot(v, right), glm::dot(v, facing)); };
+  auto local3 = [&](glm::vec3 v)
+  { return glm::vec3(glm::dot(glm::vec2(v.x, v.z), right), v.y, glm::dot(glm::vec2(v.x, v.z), facing)); };
+  auto store3 = [&](int offset, glm::vec3 v)
+  { feature[offset] = v.x, feature[offset + 1] = v.y, feature[offset + 2] = v.z; };
+
+  const glm::vec3 root3(root.x, 0.f, root.y);
+  store3(LeftFootPosition, local3(samples.leftFoot[i] - root3));
+  store3(RightFootPosition, local3(samples.rightFoot[i] - root3));
+  store3(LeftFootVelocity, local3(extrapolate(samples.leftFoot, i + 1) - samples.leftFoot[i]) * settings.sampleRate);
+  store3(RightFootVelocity, local3(extrapolate(samples.rightFoot, i + 1) - samples.rightFoot[i]) * settings.sampleRate);
+  store3(HipVelocity, local3(extrapolate(samples.hips, i + 1) - samples.hips[i]) * settings.sampleRate);
+  for (int k = 0; k < MotionTrajectorySamples; k++)
+  {
+    const int future = i + settings.trajectoryFrames[k];
+    const glm::vec3 hips = extrapolate(samples.hips, future);
+    const glm::vec2 position = local2(glm::vec2(hips.x, hips.z) - root);
+    const glm::vec2 direction = local2(samples.facing[std::min(future, samples.count() - 1)]);
+    feature[TrajectoryPosition + k * 2] = position.x;
+    feature[TrajectoryPosition + k * 2 + 1] = position.y;
+    feature[TrajectoryDirection + k * 2] = direction.x;
+    feature[TrajectoryDirection + k * 2 + 1] = direction.y;
+  }
+}
+
+// Every group gets unit deviation times its weight, so positions in meters and velocities in m/s weigh the same.
+static void compute_normalization(MotionDatabase &database, const std::vector<float> &raw, const MotionFeatureSettings &settings)
+{
+  struct Group
+  {
+    int from, to;
+    float weight;
+  };
+  const Group groups[] = {
+      {LeftFootPosition, LeftFootVelocity, settings.footPositionWeight},
+      {LeftFootVelocity, HipVelocity, settings.footVelocityWeight},
+      {HipVelocity, TrajectoryPosition, settings.hipVelocityWeight},
+      {TrajectoryPosition, TrajectoryDirection, settings.trajectoryPositionWeight},
+      {TrajectoryDirection, MotionFeatureCount, settings.trajectoryDirectionWeight},
+  };
+  const int frames = database.frameCount;
+  for (int f = 0; f < MotionFeatureCount; f++)
+  {
+    double sum = 0.0;
+    for (int i = 0; i < frames; i++)
+      sum += raw[i * MotionFeatureCount + f];
+    database.mean[f] = sum / frames;
+  }
+  for (const Group &group : groups)
+  {
+    double variance = 0.0;
+    for (int f = group.from; f < group.to; f++)
+      for (int i = 0; i < frames; i++)
+      {
+        const double d = raw[i * MotionFeatureCount + f] - database.mean[f];
+        variance += d * d;
+      }
+    variance /= double(frames) * (group.to - group.from);
+    const float deviation = std::max(float(sqrt(variance)), 1e-5f);
+    for (int f = group.from; f < group.to; f++)
+      database.scale[f] = group.weight / deviation;
+  }
+}
+
+// Splits on the widest feature at a median rounded to 4 slots, so leaves stay aligned for the SIMD scan.
+static int build_kd_tree(MotionDatabase &database, const std::vector<float> &normalized, std::vector<int> &order, int begin, int end, int leaf_size)
+{
+  const int index = database.nodes.size();
+  database.nodes.push_back({-1, 0.f, -1, -1, begin, end});
+  const int mid = begin + (((end - begin) / 2 + 3) & ~3);
+  if (end - begin <= leaf_size || mid >= end)
+    return index;
+
+  int feature = 0;
+  float widest = -1.f;
+  for (int f = 0; f < MotionFeatureCount; f++)
+  {
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    for (int i = begin; i < end; i++)
+    {
+      const float value = normalized[order[i] * MotionFeatureCount + f];
+      lo = std::min(lo, value);
+      hi = std::max(hi, value);
+    }
+    if (hi - lo > widest)
+    {
+      widest = hi - lo;
+      feature = f;
+    }
+  }
+  std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b)
+                   { return normalized[a * MotionFeatureCount + feature] < normalized[b * MotionFeatureCount + feature]; });
+
+  // read before the children reorder their halves
+  const float split = normalized[order[mid] * MotionFeatureCount + feature];
+  const int left = build_kd_tree(database, normalized, order, begin, mid, leaf_size);
+  const int right = build_kd_tree(database, normalized, order, mid, end, leaf_size);
+  database.nodes[index] = {feature, split, left, right, begin, end};
+  return index;
+}
+
+MotionDatabase build_motion_database(const Skeleton &skeleton, const MotionJoints &joints, const std::vector<AnimationPtr> &clips,
+                                     const MotionFeatureSettings &settings)
+{
+  MotionDatabase database;
+  const int numJoints = skeleton.skeleton->num_joints();
+  if (joints.hips < 0 || joints.leftFoot < 0 || joints.rightFoot < 0 || settings.sampleRate <= 0.f)
+  {
+    debug_error("motion database needs hips and feet joints and a sample rate");
+    return database;
+  }
+
+  ozz::animation::SamplingJob::Context context(numJoints);
+  std::vector<float> raw;
+  std::vector<int> frameClip;
+  std::vector<float> frameTime;
+  for (const AnimationPtr &clip : clips)
+  {
+    if (!clip || clip->num_tracks() != numJoints)
+    {
+      debug_error("motion database skips clip %s, it does not match the skeleton", clip ? clip->name() : "null");
+      continue;
+    }
+    ClipSamples samples;
+    if (!sample_clip(skeleton, joints, *clip, settings.sampleRate, context, samples))
+    {
+      debug_error("motion database failed to sample %s", clip->name());
+      continue;
+    }
+    const int clipIndex = database.clipNames.size();
+    database.clipNames.emplace_back(clip->name());
+    for (int i = 0; i < samples.count(); i++)
+    {
+      raw.resize(raw.size() + MotionFeatureCount);
+      extract_features(samples, i, settings, &raw[raw.size() - MotionFeatureCount]);
+      frameClip.push_back(clipIndex);
+      frameTime.push_back(std::min(i / settings.sampleRate, clip->duration()));
+    }
+  }
+  database.frameCount = frameClip.size();
+  if (database.frameCount == 0)
+    return database;
+
+  compute_normalization(database, raw, settings);
+  for (int i = 0; i < database.frameCount; i++)
+    normalize_motion_feature(database, &raw[i * MotionFeatureCount], &raw[i * MotionFeatureCount]);
+
+  std::vector<int> order(database.frameCount);
+  for (int i = 0; i < database.frameCount; i++)
+    order[i] = i;
+  build_kd_tree(database, raw, order, 0, database.frameCount, std::max(settings.leafSize & ~3, 4));
+
+  database.stride = (database.frameCount + 3) & ~3;
+  database.features.assign(size_t(database.stride) * MotionFeatureCount, PaddingFeature);
+  database.frameClip.resize(database.frameCount);
+  database.frameTime.resize(database.frameCount);
+  for (int slot = 0; slot < database.frameCount; slot++)
+  {
+    const int frame = order[slot];
+    for (int f = 0; f < MotionFeatureCount; f++)
+      database.features[f * database.stride + slot] = raw[frame * MotionFeatureCount + f];
+    database.frameClip[slot] = frameClip[frame];
+    database.frameTime[slot] = frameTime[frame];
+  }
+  debug_log("motion database: %d frames from %d clips, %d kd-tree nodes", database.frameCount, (int)database.clipNames.size(),
+            (int)database.nodes.size());
+  return database;
+}
+
+static const uint32_t MotionDatabaseMagic = 0x42444d4d; // "MMDB"
+static const uint32_t MotionDatabaseVersion = 1;
+
+template<typename T>
+static void write_vector(std::ofstream &file, const std::vector<T> &values)
+{
+  const uint32_t size = values.size();
+  file.write((const char *)&size, sizeof(size));
+  file.write((const char *)values.data(), sizeof(T) * size);
+}
+
+template<typename T>
+static bool read_vector(std::ifstream &file, std::vector<T> &values)
+{
+  uint32_t size = 0;
+  if (!file.read((char *)&size, sizeof(size)))
+    return false;
+  // a corrupt size must not allocate more than the file holds
+  const std::streampos position = file.tellg();
+  file.seekg(0, std::ios::end);
+  const std::streamoff left = file.tellg() - position;
+  file.seekg(position);
+  if (uint64_t(size) * sizeof(T) > uint64_t(left))
+    return false;
+  values.resize(size);
+  return bool(file.read((char *)values.data(), sizeof(T) * size));
+}
+
+bool save_motion_database(const MotionDatabase &database, const char *path)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+  {
+    debug_error("can't write motion database %s", path);
+    return false;
+  }
+  const uint32_t header[] = {MotionDatabaseMagic, MotionDatabaseVersion, MotionFeatureCount, uint32_t(database.frameCount), uint32_t(database.stride)};
+  file.write((const char *)header, sizeof(header));
+  file.write((const char *)database.mean, sizeof(database.mean));
+  file.write((const char *)database.scale, sizeof(database.scale));
+  write_vector(file, database.features);
+  write_vector(file, database.frameClip);
+  write_vector(file, database.frameTime);
+  write_vector(file, database.nodes);
+  const uint32_t clipCount = database.clipNames.size();
+  file.write((const char *)&clipCount, sizeof(clipCount));
+  for (const std::string &name : database.clipNames)
+    write_vector(file, std::vector<char>(name.begin(), name.end()));
+  return bool(file);
+}
+
+// Everything motion_search indexes with: slot arrays, clip indices and a kd-tree whose children follow their parent
+// and split its slot range at a multiple of 4.
+static bool valid_motion_database(const MotionDatabase &database, const char *path)
+{
+  const int frameCount = database.frameCount;
+  if (frameCount < 0 || database.stride != ((frameCount + 3) & ~3) ||
+      database.features.size() != size_t(database.stride) * MotionFeatureCount ||
+      database.frameClip.size() != size_t(frameCount) || database.frameTime.size() != size_t(frameCount))
+  {
+    debug_error("motion database %s: %d frames do not match stride %d and the slot arrays", path, frameCount, database.stride);
+    return false;
+  }
+  for (int clip : database.frameClip)
+    if (clip < 0 || clip >= (int)database.clipNames.size())
+    {
+      debug_error("motion database %s: clip %d out of %d clips", path, clip, (int)database.clipNames.size());
+      return false;
+    }
+  const int nodeCount = database.nodes.size();
+  if ((nodeCount == 0) != (frameCount == 0) || (nodeCount > 0 && (database.nodes[0].begin != 0 || database.nodes[0].end != frameCount)))
+  {
+    debug_error("motion database %s: kd-tree root does not cover the %d frames", path, frameCount);
+    return false;
+  }
+  for (int i = 0; i < nodeCount; i++)
+  {
+    const MotionDatabase::Node &node = database.nodes[i];
+    bool ok = node.begin >= 0 && node.begin % 4 == 0 && node.begin <= node.end && node.end <= frameCount;
+    if (ok && node.left < 0)
+      ok = node.right < 0;
+    else if (ok)
+    {
+      ok = node.feature >= 0 && node.feature < MotionFeatureCount && node.left > i && node.left < nodeCount &&
+           node.right > i && node.right < nodeCount;
+      if (ok)
+      {
+        const MotionDatabase::Node &left = database.nodes[node.left], &right = database.nodes[node.right];
+        ok = left.begin == node.begin && left.end == right.begin && right.end == node.end;
+      }
+    }
+    if (!ok)
+    {
+      debug_error("motion database %s: bad kd-tree node %d", path, i);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool load_motion_database(MotionDatabase &database, const char *path)
+{
+  std::ifstream file(path, std::ios::binary);
+  uint32_t header[5] = {};
+  if (!file.read((char *)header, sizeof(header)) || header[0] != MotionDatabaseMagic || header[1] != MotionDatabaseVersion ||
+      header[2] != MotionFeatureCount)
+  {
+    debug_error("%s is not a motion database of this version", path);
+    return false;
+  }
+  database = MotionDatabase();
+  if (header[3] > uint32_t(INT_MAX - 3) || header[4] > uint32_t(INT_MAX))
+  {
+    debug_error("motion database %s has a bad frame count", path);
+    return false;
+  }
+  database.frameCount = header[3];
+  database.stride = header[4];
+  uint32_t clipCount = 0;
+  bool ok = file.read((char *)database.mean, sizeof(database.mean)) && file.read((char *)database.scale, sizeof(database.scale)) &&
+            read_vector(file, database.features) && read_vector(file, database.frameClip) && read_vector(file, database.frameTime) &&
+            read_vector(file, database.nodes) && file.read((char *)&clipCount, sizeof(clipCount));
+  for (uint32_t i = 0; ok && i < clipCount; i++)
+  {
+    std::vector<char> name;
+    ok = read_vector(file, name);
+    database.clipNames.emplace_back(name.begin(), name.end());
+  }
+  if (!ok)
+  {
+    debug_error("motion database %s is truncated", path);
+    database = MotionDatabase();
+    return false;
+  }
+  if (!valid_motion_database(database, path))
+  {
+    database = MotionDatabase();
+    return false;
+  }
+  return true;
+}
+
+void normalize_motion_feature(const MotionDatabase &database, const float *raw, float *normalized)
+{
+  for (int f = 0; f < MotionFeatureCount; f++)
+    normalized[f] = (raw[f] - database.mean[f]) * database.scale[f];
+}
+
+void get_motion_feature(const MotionDatabase &database, int slot, float *normalized)
+{
+  for (int f = 0; f < MotionFeatureCount; f++)
+    normalized[f] = database.features[f * database.stride + slot];
+}
+
+struct MotionSearch
+{
+  const MotionDatabase &database;
+  const float *query;
+  ozz::math::SimdFloat4 query4[MotionFeatureCount];
+  // per feature distance from the query to the current kd-tree cell
+  float offsets[MotionFeatureCount] = {};
+  float bestCost = FLT_MAX;
+  int best = -1;
+
+  MotionSearch(const MotionDatabase &database, const float *query) : database(database), query(query)
+  {
+    for (int f = 0; f < MotionFeatureCount; f++)
+      query4[f] = ozz::math::simd_float4::Load1(query[f]);
+  }
+};
+
+// Four slots per iteration, blocks which lose to the best cost after the foot features skip the rest.
+static void search_slots(MotionSearch &search, int begin, int end)
+{
+  using namespace ozz::math;
+  const float *features = search.database.features.data();
+  const int stride = search.database.stride;
+  for (int slot = begin; slot < end; slot += 4)
+  {
+    SimdFloat4 cost = simd_float4::zero();
+    int f = 0;
+    for (; f < HipVelocity; f++)
+    {
+      const SimdFloat4 d = simd_float4::LoadPtrU(features + f * stride + slot) - search.query4[f];
+      cost = MAdd(d, d, cost);
+    }
+    SimdFloat4 best = simd_float4::Load1(search.bestCost);
+    if (MoveMask(CmpLt(cost, best)) == 0)
+      continue;
+    for (; f < MotionFeatureCount; f++)
+    {
+      const SimdFloat4 d = simd_float4::LoadPtrU(features + f * stride + slot) - search.query4[f];
+      cost = MAdd(d, d, cost);
+    }
+    if (MoveMask(CmpLt(cost, best)) == 0)
+      continue;
+    float costs[4];
+    StorePtrU(cost, costs);
+    for (int i = 0; i < 4; i++)
+      if (costs[i] < search.bestCost)
+      {
+        search.bestCost = costs[i];
+        search.best = slot + i;
+      }
+  }
+}
+
+int motion_search_brute_force(const MotionDatabase &database, const float *query, float &cost)
+{
+  MotionSearch search(database, query);
+  search_slots(search, 0, database.stride);
+  cost = search.bestCost;
+  return search.best;
+}
+
+// Near child first, the far one only when the incremental lower bound of its cell beats the best cost.
+static void search_node(MotionSearch &search, int index, float bound)
+{
+  const MotionDatabase::Node &node = search.database.nodes[index];
+  if (node.left < 0)
+  {
+    search_slots(search, node.begin, (node.end + 3) & ~3);
+    return;
+  }
+  const float diff = search.query[node.feature] - node.split;
+  search_node(search, diff < 0.f ? node.left : node.right, bound);
+
+  float &offset = search.offsets[node.feature];
+  const float farBound = bound - offset * offset + diff * diff;
+  if (farBound < search.bestCost)
+  {
+    const float nearOffset = offset;
+    offset = diff;
+    search_node(search, diff < 0.f ? node.right : node.left, farBound);
+    offset = nearOffset;
+  }
+}
+
+int motion_search(const MotionDatabase &database, const float *query, float &cost)
+{
+  MotionSearch search(database, query);
+  if (!database.nodes.empty())
+    search_node(search, 0, 0.f);
+  cost = search.bestCost;
+  return search.best;
+}
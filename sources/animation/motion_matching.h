@@ -0,0 +1,90 @@
+#pragma once
+#include <render/scene.h>
+#include <string>
+#include <vector>
+
+// Feature of one animation frame, measured in the character frame: hips projected to the ground, facing the hips forward axis.
+enum MotionFeature
+{
+  LeftFootPosition = 0,
+  RightFootPosition = 3,
+  LeftFootVelocity = 6,
+  RightFootVelocity = 9,
+  HipVelocity = 12,
+  TrajectoryPosition = 15, // xz per future sample
+  TrajectoryDirection = 21, // xz per future sample
+  MotionFeatureCount = 27
+};
+constexpr int MotionTrajectorySamples = 3;
+
+struct MotionFeatureSettings
+{
+  float sampleRate = 30.f;
+  // future trajectory samples, in frames at sampleRate
+  int trajectoryFrames[MotionTrajectorySamples] = {10, 20, 30};
+  // importance of each group after it is scaled to unit deviation
+  float footPositionWeight = 0.75f;
+  float footVelocityWeight = 1.f;
+  float hipVelocityWeight = 1.f;
+  float trajectoryPositionWeight = 1.f;
+  float trajectoryDirectionWeight = 1.5f;
+  // frames per kd-tree leaf, a multiple of 4
+  int leafSize = 16;
+};
+
+struct MotionJoints
+{
+  int hips = -1;
+  int leftFoot = -1;
+  int rightFoot = -1;
+};
+
+// Normalized features of every frame of a clip library, in SoA layout: features[feature * stride + slot].
+// Slots are ordered by the kd-tree so that every leaf is a contiguous run starting at a multiple of 4.
+struct MotionDatabase
+{
+  int frameCount = 0;
+  int stride = 0; // frameCount rounded up to 4, padding slots never match
+  std::vector<float> features;
+
+  // normalized = (raw - mean) * scale
+  float mean[MotionFeatureCount] = {};
+  float scale[MotionFeatureCount] = {};
+
+  // source of every slot
+  std::vector<int> frameClip;
+  std::vector<float> frameTime;
+  std::vector<std::string> clipNames;
+
+  // kd-tree over the slots, leaves have left == -1
+  struct Node
+  {
+    int feature;
+    float split;
+    int left, right;
+    int begin, end;
+  };
+  std::vector<Node> nodes;
+};
+
+// Looks the joints up by the usual hips, pelvis and foot names, case insensitive.
+bool find_motion_joints(const Skeleton &skeleton, MotionJoints &joints);
+
+// Samples every clip at settings.sampleRate and builds the normalized database with its kd-tree.
+// Trajectories past the clip end are extrapolated with the last frame velocity.
+MotionDatabase build_motion_database(const Skeleton &skeleton, const MotionJoints &joints, const std::vector<AnimationPtr> &clips,
+                                     const MotionFeatureSettings &settings = {});
+
+bool save_motion_database(const MotionDatabase &database, const char *path);
+bool load_motion_database(MotionDatabase &database, const char *path);
+
+// Applies the database normalization to raw features.
+void normalize_motion_feature(const MotionDatabase &database, const float *raw, float *normalized);
+// Normalized feature of a slot, the pose part of a query is usually taken from the playing frame.
+void get_motion_feature(const MotionDatabase &database, int slot, float *normalized);
+
+// Best matching slot for a normalized query, cost is its squared distance. Both return -1 for an empty database.
+// Checks every frame four at a time.
+int motion_search_brute_force(const MotionDatabase &database, const float *query, float &cost);
+// Exact nearest neighbour through the kd-tree, the leaves are scanned like the brute force path.
+int motion_search(const MotionDatabase &database, const float *query, float &cost);
@@ -0,0 +1,137 @@
+#include "skeleton_lod.h"
+#include "character.h"
+#include <log.h>
+#include <algorithm>
+
+#include "ozz/animation/runtime/local_to_model_job.h"
+#include "ozz/animation/runtime/skeleton.h"
+#include "ozz/animation/runtime/skeleton_utils.h"
+
+static bool is_descendant(const ozz::span<const int16_t> &parents, int joint, int ancestor)
+{
+  for (; joint >= 0; joint = parents[joint])
+    if (joint == ancestor)
+      return true;
+  return false;
+}
+
+SkeletonLod make_skeleton_lod(const Skeleton &skeleton, const std::vector<bool> &dropped)
+{
+  SkeletonLod lod;
+  const auto parents = skeleton.skeleton->joint_parents();
+  const int numJoints = skeleton.skeleton->num_joints();
+  for (int i = 0; i < numJoints; i++)
+  {
+    if (dropped[i])
+    {
+      int ancestor = parents[i];
+      while (ancestor >= 0 && dropped[ancestor])
+        ancestor = parents[ancestor];
+      if (ancestor < 0)
+        continue;
+      lod.dropped.push_back({i, ancestor, ozz::math::Invert(skeleton.bindPose[ancestor]) * skeleton.bindPose[i]});
+      continue;
+    }
+    // parents come before children, a range grows while the next kept joint stays under its first joint
+    if (!lod.ranges.empty() && lod.ranges.back().to == i - 1 && is_descendant(parents, i, lod.ranges.back().from))
+      lod.ranges.back().to = i;
+    else
+      lod.ranges.push_back({i, i});
+  }
+  return lod;
+}
+
+SkeletonLod make_skeleton_lod(const Skeleton &skeleton, const std::vector<std::string> &dropped_roots)
+{
+  const auto parents = skeleton.skeleton->joint_parents();
+  const int numJoints = skeleton.skeleton->num_joints();
+  std::vector<bool> dropped(numJoints, false);
+  for (const std::string &name : dropped_roots)
+  {
+    const int joint = ozz::animation::FindJoint(*skeleton.skeleton, name.c_str());
+    if (joint < 0)
+      debug_error("skeleton lod joint %s not found", name.c_str());
+    else
+      dropped[joint] = true;
+  }
+  for (int i = 0; i < numJoints; i++)
+    if (parents[i] >= 0 && dropped[parents[i]])
+      dropped[i] = true;
+  return make_skeleton_lod(skeleton, dropped);
+}
+
+void init_skeleton_lods(Character &character, int count)
+{
+  const Skeleton &skeleton = *character.skeleton_;
+  const auto parents = skeleton.skeleton->joint_parents();
+  const int numJoints = skeleton.skeleton->num_joints();
+
+  // rest pose model space skin box of every subtree, children come after their parent
+  std::vector<BoneBounds> subtree(numJoints);
+  std::vector<int> depth(numJoints, 0);
+  for (int i = 0; i < numJoints && i < (int)character.jointBounds.size(); i++)
+  {
+    const BoneBounds &bone = character.jointBounds[i];
+    if (bone.empty())
+      continue;
+    for (int corner = 0; corner < 8; corner++)
+    {
+      const vec3 p((corner & 1) ? bone.boxMax.x : bone.boxMin.x, (corner & 2) ? bone.boxMax.y : bone.boxMin.y,
+                   (corner & 4) ? bone.boxMax.z : bone.boxMin.z);
+      alignas(16) float model[4];
+      ozz::math::StorePtr(ozz::math::TransformPoint(skeleton.bindPose[i], ozz::math::simd_float4::Load(p.x, p.y, p.z, 1.f)), model);
+      subtree[i].boxMin = min(subtree[i].boxMin, vec3(model[0], model[1], model[2]));
+      subtree[i].boxMax = max(subtree[i].boxMax, vec3(model[0], model[1], model[2]));
+    }
+  }
+  for (int i = 0; i < numJoints; i++)
+    if (parents[i] >= 0)
+      depth[i] = depth[parents[i]] + 1;
+  for (int i = numJoints - 1; i > 0; i--)
+  {
+    const int parent = parents[i];
+    if (parent < 0 || subtree[i].empty())
+      continue;
+    subtree[parent].boxMin = min(subtree[parent].boxMin, subtree[i].boxMin);
+    subtree[parent].boxMax = max(subtree[parent].boxMax, subtree[i].boxMax);
+  }
+  float total = 0.f;
+  for (const BoneBounds &bounds : subtree)
+    if (!bounds.empty())
+      total = std::max(total, length(bounds.boxMax - bounds.boxMin));
+
+  static const float SkinFraction[] = {0.f, 0.05f, 0.12f, 0.2f};
+  const int MinDroppedDepth = 3;
+  character.skeletonLods.assign(1, SkeletonLod());
+  for (int level = 1; level < count && level < (int)std::size(SkinFraction); level++)
+  {
+    std::vector<bool> dropped(numJoints, false);
+    for (int i = 0; i < numJoints; i++)
+    {
+      const float size = subtree[i].empty() ? 0.f : length(subtree[i].boxMax - subtree[i].boxMin);
+      dropped[i] = (parents[i] >= 0 && dropped[parents[i]]) || (depth[i] >= MinDroppedDepth && size < SkinFraction[level] * total);
+    }
+    character.skeletonLods.push_back(make_skeleton_lod(skeleton, dropped));
+    debug_log("skeleton lod %d: %d of %d joints, %d ltm ranges", level, numJoints - int(character.skeletonLods.back().dropped.size()),
+              numJoints, int(character.skeletonLods.back().ranges.size()));
+  }
+}
+
+bool local_to_model_lod(const Skeleton &skeleton, const SkeletonLod &lod, const std::vector<ozz::math::SoaTransform> &locals,
+                        std::vector<ozz::math::Float4x4> &models)
+{
+  for (const SkeletonLod::Range &range : lod.ranges)
+  {
+    ozz::animation::LocalToModelJob ltm_job;
+    ltm_job.skeleton = skeleton.skeleton.get();
+    ltm_job.input = ozz::make_span(locals);
+    ltm_job.output = ozz::make_span(models);
+    ltm_job.from = range.from;
+    ltm_job.to = range.to;
+    if (!ltm_job.Run())
+      return false;
+  }
+  for (const SkeletonLod::Dropped &joint : lod.dropped)
+    models[joint.joint] = models[joint.ancestor] * joint.offset;
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ozz/base/maths/simd_math.h"
+#include "ozz/base/maths/soa_transform.h"
+
+struct Character;
+struct Skeleton;
+
+// Truncated joint set of a skeleton. Kept joints run LocalToModelJob over from/to ranges, dropped joints follow
+// their nearest kept ancestor rigidly with the bind pose offset between them.
+struct SkeletonLod
+{
+  struct Range
+  {
+    int from, to;
+  };
+  // contiguous kept descendants of from, in joint order so parents are computed first
+  std::vector<Range> ranges;
+
+  struct Dropped
+  {
+    int joint, ancestor;
+    ozz::math::Float4x4 offset;
+  };
+  std::vector<Dropped> dropped;
+};
+
+// Drops the subtrees marked in dropped, dropped[i] must be set for every descendant of a dropped joint.
+SkeletonLod make_skeleton_lod(const Skeleton &skeleton, const std::vector<bool> &dropped);
+
+// Authored level, drops the subtrees of the named joints.
+SkeletonLod make_skeleton_lod(const Skeleton &skeleton, const std::vector<std::string> &dropped_roots);
+
+// Levels 1..count-1 drop subtrees deeper than 2 joints whose skin is small against the whole character,
+// like fingers, face and twist joints. Fills Character::skeletonLods, level 0 is the full skeleton.
+void init_skeleton_lods(Character &character, int count);
+
+// Runs LocalToModelJob for the kept joints of lod and fills the dropped ones, output holds all joints.
+bool local_to_model_lod(const Skeleton &skeleton, const SkeletonLod &lod, const std::vector<ozz::math::SoaTransform> &locals,
+                        std::vector<ozz::math::Float4x4> &models);
@@ -0,0 +1,277 @@
+#include "synthetic.h"
+#include <log.h>
+#include <algorithm>
+#include <string>
+
+#include <assimp/scene.h>
+
+#include "ozz/animation/offline/raw_skeleton.h"
+#include "ozz/animation/offline/raw_animation.h"
+#include "ozz/animation/runtime/skeleton.h"
+#include "ozz/animation/runtime/skeleton_utils.h"
+
+using RawJoint = ozz::animation::offline::RawSkeleton::Joint;
+
+ozz::animation::offline::RawSkeleton make_synthetic_raw_skeleton(const SyntheticSettings &settings)
+{
+  SyntheticRandom random(settings.seed);
+  int jointCount = std::max(settings.joints, 1);
+  int depth = std::max(settings.depth, 1);
+
+  // First joints form the longest chain, the rest are attached to random joints above the depth limit.
+  std::vector<int> parents(jointCount, -1), depths(jointCount, 0);
+  std::vector<int> openJoints = {0};
+  for (int i = 1; i < jointCount; i++)
+  {
+    int parent = i < depth ? i - 1 : openJoints[random.next() % openJoints.size()];
+    parents[i] = parent;
+    depths[i] = depths[parent] + 1;
+    if (depths[i] + 1 < depth)
+      openJoints.push_back(i);
+  }
+
+  std::vector<std::vector<int>> children(jointCount);
+  for (int i = 1; i < jointCount; i++)
+    children[parents[i]].push_back(i);
+
+  ozz::animation::offline::RawSkeleton rawSkeleton;
+  rawSkeleton.roots.resize(1);
+  auto build = [&](auto &&self, RawJoint &joint, int idx) -> void
+  {
+    joint.name = "joint_" + std::to_string(idx);
+    joint.transform = ozz::math::Transform::identity();
+    if (idx > 0)
+    {
+      float angle = random.next_float(-0.6f, 0.6f);
+      joint.transform.translation = ozz::math::Float3(random.next_float(-0.02f, 0.02f), 0.1f, random.next_float(-0.02f, 0.02f));
+      joint.transform.rotation = ozz::math::Quaternion::FromAxisAngle(ozz::math::Float3(0.f, 0.f, 1.f), angle);
+    }
+    joint.children.resize(children[idx].size());
+    for (size_t i = 0; i < children[idx].size(); i++)
+      self(self, joint.children[i], children[idx][i]);
+  };
+  build(build, rawSkeleton.roots[0], 0);
+  return rawSkeleton;
+}
+
+ozz::animation::offline::RawAnimation make_synthetic_raw_animation(const SyntheticSettings &settings, const Skeleton &skeleton)
+{
+  using RawAnimation = ozz::animation::offline::RawAnimation;
+  SyntheticRandom random(settings.seed * 31u + 7u);
+  const ozz::animation::Skeleton &ozzSkeleton = *skeleton.skeleton;
+
+  RawAnimation rawAnimation;
+  rawAnimation.name = "synthetic_" + std::to_string(settings.seed);
+  rawAnimation.duration = std::max(settings.duration, 0.01f);
+  int keys = std::max(int(rawAnimation.duration * settings.keysPerSecond) + 1, 2);
+
+  rawAnimation.tracks.resize(ozzSkeleton.num_joints());
+  for (int jointIdx = 0; jointIdx < ozzSkeleton.num_joints(); jointIdx++)
+  {
+    const ozz::math::Transform restPose = ozz::animation::GetJointLocalRestPose(ozzSkeleton, jointIdx);
+    RawAnimation::JointTrack &track = rawAnimation.tracks[jointIdx];
+    float phase = random.next_float(0.f, PITWO);
+    float amplitude = random.next_float(0.1f, 0.5f);
+    ozz::math::Float3 axis = ozz::math::Normalize(ozz::math::Float3(random.next_float(-1, 1), random.next_float(-1, 1), 1.f));
+
+    track.translations.resize(keys);
+    track.rotations.resize(keys);
+    track.scales.resize(keys);
+    for (int k = 0; k < keys; k++)
+    {
+      float time = rawAnimation.duration * k / (keys - 1);
+      float angle = amplitude * sinf(PITWO * k / (keys - 1) + phase);
+      track.translations[k] = RawAnimation::TranslationKey{time, restPose.translation};
+      track.rotations[k] = RawAnimation::RotationKey{time, restPose.rotation * ozz::math::Quaternion::FromAxisAngle(axis, angle)};
+      track.scales[k] = RawAnimation::ScaleKey{time, restPose.scale};
+    }
+  }
+  return rawAnimation;
+}
+
+MeshData make_synthetic_mesh_data(const SyntheticSettings &settings, const Skeleton &skeleton)
+{
+  SyntheticRandom random(settings.seed * 17u + 3u);
+  const ozz::animation::Skeleton &ozzSkeleton = *skeleton.skeleton;
+  const auto parents = ozzSkeleton.joint_parents();
+  const int jointCount = ozzSkeleton.num_joints();
+  const int influences = glm::clamp(settings.influences, 1, 4);
+
+  MeshData data;
+  int triangles = std::max(settings.vertices / 3, 1);
+  int vertexCount = triangles * 3;
+  data.vertices.resize(vertexCount);
+  data.normals.resize(vertexCount);
+  data.uv.resize(vertexCount);
+  data.weights.resize(vertexCount, vec4(0.f));
+  data.weightsIndex.resize(vertexCount, uvec4(0));
+  data.indices.resize(vertexCount);
+
+  for (int t = 0; t < triangles; t++)
+  {
+    int joint = t % jointCount;
+    vec3 center;
+    ozz::math::Store3PtrU(skeleton.bindPose[joint].cols[3], glm::value_ptr(center));
+
+    // joint and its closest ancestors, with decreasing weights
+    uvec4 bones(joint);
+    vec4 weights(0.f);
+    float weightSum = 0.f;
+    for (int i = 0, bone = joint; i < influences; i++)
+    {
+      bones[i] = bone;
+      weights[i] = 1.f / (i + 1);
+      weightSum += weights[i];
+      if (parents[bone] >= 0)
+        bone = parents[bone];
+    }
+    weights /= weightSum;
+
+    for (int i = 0; i < 3; i++)
+    {
+      int v = t * 3 + i;
+      vec3 offset = vec3(random.next_float(-1, 1), random.next_float(-1, 1), random.next_float(-1, 1));
+      data.vertices[v] = center + offset * 0.03f;
+      data.normals[v] = glm::length(offset) > 0.f ? glm::normalize(offset) : vec3(0, 1, 0);
+      data.uv[v] = vec2(random.next_float(), random.next_float());
+      data.weights[v] = weights;
+      data.weightsIndex[v] = bones;
+      data.indices[v] = v;
+    }
+  }
+  data.invBindPose = skeleton.invBindPose;
+  data.rootJoint = 0;
+  return data;
+}
+
+SceneAsset make_synthetic_scene(const SyntheticSettings &settings, int load_flags, int clip_count)
+{
+  SceneAsset result;
+  result.skeleton = create_skeleton(make_synthetic_raw_skeleton(settings));
+  if (!result.skeleton)
+    return result;
+
+  if (load_flags & SceneAsset::LoadScene::Meshes)
+    result.meshes.emplace_back(create_mesh(make_synthetic_mesh_data(settings, *result.skeleton)));
+
+  const bool additive = load_flags & SceneAsset::LoadScene::AdditiveAnimation;
+  if (load_flags & (SceneAsset::LoadScene::Animation | SceneAsset::LoadScene::AdditiveAnimation))
+    for (int i = 0; i < clip_count; i++)
+    {
+      SyntheticSettings clipSettings = settings;
+      clipSettings.seed = settings.seed + i;
+      if (AnimationPtr animation = create_animation(make_synthetic_raw_animation(clipSettings, *result.skeleton), result.skeleton, additive))
+        result.animations.emplace_back(std::move(animation));
+    }
+  return result;
+}
+
+static aiNode *make_ai_node(const RawJoint &joint)
+{
+  aiNode *node = new aiNode(joint.name.c_str());
+  const ozz::math::Transform &t = joint.transform;
+  node->mTransformation = aiMatrix4x4(aiVector3D(t.scale.x, t.scale.y, t.scale.z),
+                                      aiQuaternion(t.rotation.w, t.rotation.x, t.rotation.y, t.rotation.z),
+                                      aiVector3D(t.translation.x, t.translation.y, t.translation.z));
+  std::vector<aiNode *> children;
+  for (const RawJoint &child : joint.children)
+    children.push_back(make_ai_node(child));
+  if (!children.empty())
+    node->addChildren(children.size(), children.data());
+  return node;
+}
+
+aiNode *make_synthetic_ai_hierarchy(const SyntheticSettings &settings)
+{
+  return make_ai_node(make_synthetic_raw_skeleton(settings).roots[0]);
+}
+
+aiAnimation *make_synthetic_ai_animation(const SyntheticSettings &settings, const Skeleton &skeleton)
+{
+  const ozz::animation::offline::RawAnimation raw = make_synthetic_raw_animation(settings, skeleton);
+  const auto names = skeleton.skeleton->joint_names();
+  aiAnimation *animation = new aiAnimation();
+  animation->mName = aiString(raw.name.c_str());
+  // keys are in seconds
+  animation->mTicksPerSecond = 1.0;
+  animation->mDuration = raw.duration;
+  animation->mNumChannels = raw.tracks.size();
+  animation->mChannels = new aiNodeAnim *[animation->mNumChannels];
+  for (size_t i = 0; i < raw.tracks.size(); i++)
+  {
+    const auto &track = raw.tracks[i];
+    aiNodeAnim *channel = animation->mChannels[i] = new aiNodeAnim();
+    channel->mNodeName = aiString(names[i]);
+    channel->mNumPositionKeys = track.translations.size();
+    channel->mNumRotationKeys = track.rotations.size();
+    channel->mNumScalingKeys = track.scales.size();
+    channel->mPositionKeys = new aiVectorKey[channel->mNumPositionKeys];
+    channel->mRotationKeys = new aiQuatKey[channel->mNumRotationKeys];
+    channel->mScalingKeys = new aiVectorKey[channel->mNumScalingKeys];
+    for (size_t k = 0; k < track.translations.size(); k++)
+    {
+      const auto &key = track.translations[k];
+      channel->mPositionKeys[k] = aiVectorKey(key.time, aiVector3D(key.value.x, key.value.y, key.value.z));
+    }
+    for (size_t k = 0; k < track.rotations.size(); k++)
+    {
+      const auto &key = track.rotations[k];
+      channel->mRotationKeys[k] = aiQuatKey(key.time, aiQuaternion(key.value.w, key.value.x, key.value.y, key.value.z));
+    }
+    for (size_t k = 0; k < track.scales.size(); k++)
+    {
+      const auto &key = track.scales[k];
+      channel->mScalingKeys[k] = aiVectorKey(key.time, aiVector3D(key.value.x, key.value.y, key.value.z));
+    }
+  }
+  return animation;
+}
+
+aiMesh *make_synthetic_ai_mesh(const SyntheticSettings &settings, const Skeleton &skeleton)
+{
+  const MeshData data = make_synthetic_mesh_data(settings, skeleton);
+  const int vertexCount = data.vertices.size();
+  aiMesh *mesh = new aiMesh();
+  mesh->mName = aiString("synthetic");
+  mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+  mesh->mNumVertices = vertexCount;
+  mesh->mVertices = new aiVector3D[vertexCount];
+  mesh->mNormals = new aiVector3D[vertexCount];
+  mesh->mTextureCoords[0] = new aiVector3D[vertexCount];
+  mesh->mNumUVComponents[0] = 2;
+  for (int i = 0; i < vertexCount; i++)
+  {
+    mesh->mVertices[i] = aiVector3D(data.vertices[i].x, data.vertices[i].y, data.vertices[i].z);
+    mesh->mNormals[i] = aiVector3D(data.normals[i].x, data.normals[i].y, data.normals[i].z);
+    mesh->mTextureCoords[0][i] = aiVector3D(data.uv[i].x, data.uv[i].y, 0.f);
+  }
+  mesh->mNumFaces = data.indices.size() / 3;
+  mesh->mFaces = new aiFace[mesh->mNumFaces];
+  for (unsigned f = 0; f < mesh->mNumFaces; f++)
+  {
+    mesh->mFaces[f].mNumIndices = 3;
+    mesh->mFaces[f].mIndices = new unsigned[3]{data.indices[f * 3], data.indices[f * 3 + 1], data.indices[f * 3 + 2]};
+  }
+
+  // weights regrouped per joint, the bone offset is the inverse bind pose in assimp row major layout
+  const int jointCount = skeleton.skeleton->num_joints();
+  const auto names = skeleton.skeleton->joint_names();
+  std::vector<std::vector<aiVertexWeight>> boneWeights(jointCount);
+  for (int i = 0; i < vertexCount; i++)
+    for (int j = 0; j < 4; j++)
+      if (data.weights[i][j] > 0.f)
+        boneWeights[data.weightsIndex[i][j]].push_back(aiVertexWeight(i, data.weights[i][j]));
+  mesh->mNumBones = jointCount;
+  mesh->mBones = new aiBone *[jointCount];
+  for (int i = 0; i < jointCount; i++)
+  {
+    aiBone *bone = mesh->mBones[i] = new aiBone();
+    bone->mName = aiString(names[i]);
+    bone->mOffsetMatrix = reinterpret_cast<const aiMatrix4x4 &>(skeleton.invBindPose[i]);
+    bone->mOffsetMatrix.Transpose();
+    bone->mNumWeights = boneWeights[i].size();
+    bone->mWeights = new aiVertexWeight[bone->mNumWeights];
+    std::copy(boneWeights[i].begin(), boneWeights[i].end(), bone->mWeights);
+  }
+  return mesh;
+}
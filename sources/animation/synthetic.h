@@ -0,0 +1,50 @@
+#pragma once
+#include <render/scene.h>
+#include <cstdint>
+
+struct aiNode;
+struct aiAnimation;
+struct aiMesh;
+
+// xorshift generator, the same seed gives the same data on every platform.
+struct SyntheticRandom
+{
+  uint32_t state;
+  SyntheticRandom(uint32_t seed) : state(seed * 747796405u + 2891336453u) {}
+
+  uint32_t next()
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+  float next_float() { return (next() & 0xFFFFFF) / float(0x1000000); }
+  float next_float(float from, float to) { return from + (to - from) * next_float(); }
+};
+
+// Procedural skeletons, clips and skinned meshes for scaling benchmarks, no assets needed.
+struct SyntheticSettings
+{
+  int joints = 64;
+  int depth = 8;              // longest root to leaf chain, in joints
+  float duration = 1.f;       // clip length in seconds
+  float keysPerSecond = 30.f; // key density of every track
+  int vertices = 10000;
+  int influences = 4;         // joints per vertex, up to 4
+  uint32_t seed = 1;
+};
+
+ozz::animation::offline::RawSkeleton make_synthetic_raw_skeleton(const SyntheticSettings &settings);
+// Tracks follow the runtime joint order of skeleton, clips with different seeds differ in phase and amplitude.
+ozz::animation::offline::RawAnimation make_synthetic_raw_animation(const SyntheticSettings &settings, const Skeleton &skeleton);
+// Triangle soup around the bind pose bones, skinned to a joint and its ancestors.
+MeshData make_synthetic_mesh_data(const SyntheticSettings &settings, const Skeleton &skeleton);
+
+// The same data as assimp input, for benchmarks of the import conversions. The caller deletes the results.
+aiNode *make_synthetic_ai_hierarchy(const SyntheticSettings &settings);
+aiAnimation *make_synthetic_ai_animation(const SyntheticSettings &settings, const Skeleton &skeleton);
+aiMesh *make_synthetic_ai_mesh(const SyntheticSettings &settings, const Skeleton &skeleton);
+
+// Same result as load_scene with the same flags, Meshes needs a GL context.
+SceneAsset make_synthetic_scene(const SyntheticSettings &settings, int load_flags, int clip_count = 1);
@@ -0,0 +1,44 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <alloc_tracker.h>
+
+inline float benchmarkMinTime = 0.25f; // seconds per case
+
+template<typename T>
+inline void do_not_optimize(const T &value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Calls f until benchmarkMinTime is spent and reports time per call, per processed item and heap allocations per call.
+template<typename F>
+void run_benchmark(const char *name, int items, const char *item_name, F &&f)
+{
+  using clock = std::chrono::high_resolution_clock;
+  f();
+  // the first call warms caches and buffers up, the second shows steady state allocations
+  AllocScope steadyAllocs;
+  f();
+  const AllocStats allocs = steadyAllocs.delta();
+  int iterations = 0;
+  int batch = 1;
+  auto start = clock::now();
+  std::chrono::duration<double> elapsed(0);
+  while (elapsed.count() < benchmarkMinTime)
+  {
+    for (int i = 0; i < batch; i++)
+      f();
+    iterations += batch;
+    batch *= 2;
+    elapsed = clock::now() - start;
+  }
+  double ns = elapsed.count() * 1e9 / iterations;
+  double perItem = ns / (items > 0 ? items : 1);
+  printf("%-44s %10d it %14.1f ns/op %10.2f ns/%s %10.2f M%s/s %6llu allocs/op\n",
+         name, iterations, ns, perItem, item_name, 1e3 / perItem, item_name, (unsigned long long)allocs.count);
+  fflush(stdout);
+}
+
+// joints x characters x layers crowd update sweep on synthetic assets, see scaling.cpp
+void run_scaling_sweep();
@@ -0,0 +1,258 @@
+#include "benchmark.h"
+#include <animation/character.h>
+#include <animation/blend_tree.h>
+#include <animation/motion_matching.h>
+#include <animation/synthetic.h>
+#include <render/mesh_optimize.h>
+#include <command_line.h>
+#include <log.h>
+#include <algorithm>
+#include <string>
+
+#include <assimp/scene.h>
+#include <assimp/Importer.hpp>
+
+#include "ozz/animation/offline/raw_skeleton.h"
+#include "ozz/animation/runtime/blending_job.h"
+#include "ozz/animation/runtime/local_to_model_job.h"
+#include "ozz/animation/runtime/skeleton.h"
+
+static void run_suite(const std::string &label, const aiNode &root, const aiAnimation *ai_animation, const std::vector<const aiMesh *> &meshes)
+{
+  auto name = [&](const char *bench) { return (label + "/" + bench); };
+
+  SkeletonPtr skeleton = create_skeleton(root);
+  if (!skeleton)
+    return;
+  const ozz::animation::Skeleton &ozzSkeleton = *skeleton->skeleton;
+  const int numJoints = ozzSkeleton.num_joints();
+  const int numSoaJoints = ozzSkeleton.num_soa_joints();
+
+  run_benchmark(name("create_skeleton").c_str(), numJoints, "joint", [&]()
+                { do_not_optimize(create_skeleton(root)); });
+
+  for (const aiMesh *mesh : meshes)
+    run_benchmark(name("create_mesh_data").c_str(), mesh->mNumVertices, "vertex", [&]()
+                  { do_not_optimize(create_mesh_data(mesh, skeleton)); });
+
+  for (const aiMesh *mesh : meshes)
+  {
+    const MeshData source = create_mesh_data(mesh, skeleton);
+    run_benchmark(name("optimize_mesh").c_str(), mesh->mNumVertices, "vertex", [&]()
+                  {
+      MeshData data = source;
+      optimize_mesh(data);
+      do_not_optimize(data.indices.data()); });
+  }
+
+  if (!ai_animation)
+    return;
+  AnimationPtr animation = create_animation(*ai_animation, skeleton, false);
+  if (!animation)
+    return;
+
+  run_benchmark(name("create_animation").c_str(), numJoints, "joint", [&]()
+                { do_not_optimize(create_animation(*ai_animation, skeleton, false)); });
+
+  ozz::animation::SamplingJob::Context context(numJoints);
+  const int numLayers = 3;
+  std::vector<std::vector<ozz::math::SoaTransform>> locals(numLayers, std::vector<ozz::math::SoaTransform>(numSoaJoints));
+  float ratio = 0.f;
+  run_benchmark(name("sampling").c_str(), numJoints, "joint", [&]()
+                {
+    ozz::animation::SamplingJob sampling_job;
+    sampling_job.animation = animation.get();
+    sampling_job.context = &context;
+    sampling_job.ratio = ratio = ratio + 0.013f > 1.f ? 0.f : ratio + 0.013f;
+    sampling_job.output = ozz::make_span(locals[0]);
+    do_not_optimize(sampling_job.Run()); });
+
+  for (int i = 0; i < numLayers; i++)
+  {
+    ozz::animation::SamplingJob sampling_job;
+    sampling_job.animation = animation.get();
+    sampling_job.context = &context;
+    sampling_job.ratio = float(i) / numLayers;
+    sampling_job.output = ozz::make_span(locals[i]);
+    sampling_job.Run();
+  }
+
+  std::vector<ozz::math::SoaTransform> blended(numSoaJoints);
+  std::vector<ozz::animation::BlendingJob::Layer> layers(numLayers);
+  for (int i = 0; i < numLayers; i++)
+  {
+    layers[i].transform = ozz::make_span(locals[i]);
+    layers[i].weight = 1.f / numLayers;
+  }
+  run_benchmark(name("blending x3").c_str(), numJoints, "joint", [&]()
+                {
+    ozz::animation::BlendingJob blend_job;
+    blend_job.threshold = 0.1f;
+    blend_job.layers = ozz::make_span(layers);
+    blend_job.rest_pose = ozzSkeleton.joint_rest_poses();
+    blend_job.output = ozz::make_span(blended);
+    do_not_optimize(blend_job.Run()); });
+
+  std::vector<ozz::math::Float4x4> models(numJoints);
+  run_benchmark(name("local_to_model").c_str(), numJoints, "joint", [&]()
+                {
+    ozz::animation::LocalToModelJob ltm_job;
+    ltm_job.skeleton = &ozzSkeleton;
+    ltm_job.input = ozz::make_span(blended);
+    ltm_job.output = ozz::make_span(models);
+    do_not_optimize(ltm_job.Run()); });
+
+  std::vector<ozz::math::Float4x4> palette;
+  run_benchmark(name("build_palette").c_str(), numJoints, "joint", [&]()
+                {
+    build_palette(models, skeleton->invBindPose, palette);
+    do_not_optimize(palette.data()); });
+
+  Character character;
+  character.skeleton_ = skeleton;
+  character.locals_.resize(numSoaJoints);
+  character.models_.resize(numJoints);
+  character.context_ = std::make_shared<ozz::animation::SamplingJob::Context>(numJoints);
+  character.currentAnimation = animation;
+  character.controller.Reset();
+  run_benchmark(name("update_character").c_str(), numJoints, "joint", [&]()
+                { update_character(character, 1.f / 60.f); });
+
+  // locomotion sized tree, the speed parameter lands between two of the eight clips
+  const int numClips = 8;
+  auto tree = std::make_shared<BlendTree>();
+  std::vector<std::pair<int, float>> clips;
+  for (int i = 0; i < numClips; i++)
+    clips.emplace_back(add_clip_node(*tree, skeleton, animation), float(i));
+  add_blend1d_node(*tree, add_parameter(*tree, "speed", 2.5f), clips);
+  character.blendTree = tree;
+  run_benchmark(name("update_character blend tree 2/8").c_str(), numJoints, "joint", [&]()
+                { update_character(character, 1.f / 60.f); });
+}
+
+// Assimp inputs are converted from the same procedural data as the scaling sweep.
+static void run_synthetic(const SyntheticSettings &settings)
+{
+  SkeletonPtr skeleton = create_skeleton(make_synthetic_raw_skeleton(settings));
+  if (!skeleton)
+    return;
+  aiNode *root = make_synthetic_ai_hierarchy(settings);
+  aiAnimation *animation = make_synthetic_ai_animation(settings, *skeleton);
+  aiMesh *mesh = make_synthetic_ai_mesh(settings, *skeleton);
+
+  std::string label = "synthetic " + std::to_string(settings.joints) + "j";
+  run_suite(label, *root, animation, {mesh});
+
+  delete mesh;
+  delete animation;
+  delete root;
+}
+
+static void run_real(const char *scene_path, const char *animation_path)
+{
+  Assimp::Importer sceneImporter, animationImporter;
+  const aiScene *scene = read_scene(sceneImporter, scene_path);
+  if (!scene)
+  {
+    debug_error("no asset in %s", scene_path);
+    return;
+  }
+  const aiScene *animationScene = animation_path ? read_scene(animationImporter, animation_path) : scene;
+  const aiAnimation *animation = animationScene && animationScene->mNumAnimations > 0 ? animationScene->mAnimations[0] : nullptr;
+
+  std::vector<const aiMesh *> meshes(scene->mMeshes, scene->mMeshes + scene->mNumMeshes);
+  run_suite(std::string("real ") + scene_path, *scene->mRootNode, animation, meshes);
+}
+
+// Database of synthetic clips with at least frames frames, searched with queries near random frames.
+static void run_motion_matching(int frames)
+{
+  SyntheticSettings settings;
+  settings.duration = 4.f;
+  MotionFeatureSettings featureSettings;
+  const int framesPerClip = int(settings.duration * featureSettings.sampleRate) + 1;
+  const int clipCount = (frames + framesPerClip - 1) / framesPerClip;
+  SceneAsset asset = make_synthetic_scene(settings, SceneAsset::LoadScene::Skeleton | SceneAsset::LoadScene::Animation, clipCount);
+  if (!asset.skeleton)
+    return;
+  // the root and the ends of two chains stand in for hips and feet
+  MotionJoints joints;
+  joints.hips = 0;
+  joints.leftFoot = settings.depth - 1;
+  joints.rightFoot = asset.skeleton->skeleton->num_joints() - 1;
+  MotionDatabase database;
+  run_benchmark("motion database build", clipCount * framesPerClip, "frame", [&]()
+                { database = build_motion_database(*asset.skeleton, joints, asset.animations, featureSettings); });
+  if (database.frameCount == 0)
+    return;
+
+  SyntheticRandom random(7);
+  const int numQueries = 64;
+  std::vector<float> queries(numQueries * MotionFeatureCount);
+  for (int i = 0; i < numQueries; i++)
+  {
+    float *query = &queries[i * MotionFeatureCount];
+    get_motion_feature(database, random.next() % database.frameCount, query);
+    for (int f = 0; f < MotionFeatureCount; f++)
+      query[f] += random.next_float(-0.5f, 0.5f);
+    float bruteCost, treeCost;
+    const int brute = motion_search_brute_force(database, query, bruteCost);
+    const int tree = motion_search(database, query, treeCost);
+    if (brute != tree && bruteCost != treeCost)
+      debug_error("motion search mismatch, brute force %d (%f), kd-tree %d (%f)", brute, bruteCost, tree, treeCost);
+  }
+
+  std::string label = "motion search " + std::to_string(database.frameCount) + "f ";
+  int next = 0;
+  run_benchmark((label + "brute force").c_str(), database.frameCount, "frame", [&]()
+                {
+    float cost;
+    next = (next + 1) % numQueries;
+    do_not_optimize(motion_search_brute_force(database, &queries[next * MotionFeatureCount], cost)); });
+  run_benchmark((label + "kd-tree").c_str(), database.frameCount, "frame", [&]()
+                {
+    float cost;
+    next = (next + 1) % numQueries;
+    do_not_optimize(motion_search(database, &queries[next * MotionFeatureCount], cost)); });
+}
+
+// Usage: microbench [--joints N] [--depth N] [--duration sec] [--keys-per-second N] [--vertices N] [--influences N]
+//                   [--min-time sec]
+//                   [--fbx scene.fbx [--anim animation.fbx]]
+//                   [--motion-frames N] [--no-motion-matching]
+//                   [--sweep [--sweep-joints 16,64] [--sweep-characters 1,16] [--sweep-layers 1,2]]
+int main(int argc, char **argv)
+{
+  install_ozz_alloc_tracker();
+  init_command_line(argc, argv);
+  debug_set_quiet(true);
+  benchmarkMinTime = get_argument("--min-time", benchmarkMinTime);
+
+  SyntheticSettings settings;
+  settings.depth = get_argument("--depth", settings.depth);
+  settings.duration = get_argument("--duration", 2.f);
+  settings.keysPerSecond = get_argument("--keys-per-second", settings.keysPerSecond);
+  settings.vertices = get_argument("--vertices", 20000);
+  settings.influences = std::min(get_argument("--influences", 4), 4); // vertex format holds 4 weights
+  if (has_argument("--joints"))
+  {
+    settings.joints = get_argument("--joints", 64);
+    run_synthetic(settings);
+  }
+  else
+    for (int joints : {16, 64, 256})
+    {
+      settings.joints = joints;
+      run_synthetic(settings);
+    }
+
+  if (const char *scenePath = get_argument("--fbx"))
+    run_real(scenePath, get_argument("--anim"));
+
+  if (!has_argument("--no-motion-matching"))
+    run_motion_matching(get_argument("--motion-frames", 100000));
+
+  if (has_argument("--sweep"))
+    run_scaling_sweep();
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include "benchmark.h"
+#include <animation/character.h>
+#include <animation/synthetic.h>
+#include <command_line.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+static std::vector<int> get_int_list(const char *name, std::vector<int> default_value)
+{
+  const char *value = get_argument(name);
+  if (!value)
+    return default_value;
+  std::vector<int> result;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ','))
+    result.push_back(std::stoi(item));
+  return result;
+}
+
+static Character make_sweep_character(const SceneAsset &asset, int layers, float time_ratio)
+{
+  const int numJoints = asset.skeleton->skeleton->num_joints();
+  Character character;
+  character.skeleton_ = asset.skeleton;
+  character.locals_.resize(asset.skeleton->skeleton->num_soa_joints());
+  character.models_.resize(numJoints);
+  character.context_ = std::make_shared<ozz::animation::SamplingJob::Context>(numJoints);
+  character.currentAnimation = asset.animations[0];
+  character.controller.Reset();
+  character.controller.time_ratio_ = time_ratio;
+  // a single clip goes through the sampling only path, more clips are blended
+  if (layers > 1)
+    for (int i = 0; i < layers; i++)
+    {
+      AnimationLayer &layer = character.layers.emplace_back(asset.skeleton, asset.animations[i]);
+      layer.weight = 1.f / layers;
+      layer.controller.time_ratio_ = time_ratio;
+    }
+  return character;
+}
+
+// Times update_character and palette construction of a crowd for every joints x characters x layers combination.
+void run_scaling_sweep()
+{
+  std::vector<int> jointCounts = get_int_list("--sweep-joints", {16, 64, 256, 1000});
+  std::vector<int> characterCounts = get_int_list("--sweep-characters", {1, 16, 128});
+  std::vector<int> layerCounts = get_int_list("--sweep-layers", {1, 2, 4});
+  int maxLayers = *std::max_element(layerCounts.begin(), layerCounts.end());
+
+  for (int joints : jointCounts)
+  {
+    SyntheticSettings settings;
+    settings.joints = joints;
+    settings.depth = get_argument("--depth", settings.depth);
+    settings.keysPerSecond = get_argument("--keys-per-second", settings.keysPerSecond);
+    settings.duration = get_argument("--duration", settings.duration);
+    SceneAsset asset = make_synthetic_scene(settings, SceneAsset::LoadScene::Skeleton | SceneAsset::LoadScene::Animation, maxLayers);
+    if (!asset.skeleton || (int)asset.animations.size() < maxLayers)
+      continue;
+
+    for (int characterCount : characterCounts)
+      for (int layers : layerCounts)
+      {
+        std::vector<Character> characters;
+        characters.reserve(characterCount);
+        for (int i = 0; i < characterCount; i++)
+          characters.emplace_back(make_sweep_character(asset, layers, float(i) / characterCount));
+
+        std::vector<ozz::math::Float4x4> palette;
+        std::string name = "sweep " + std::to_string(joints) + "j x " + std::to_string(characterCount) + "c x " + std::to_string(layers) + "l";
+        run_benchmark(name.c_str(), joints * characterCount, "joint", [&]()
+                      {
+          for (Character &character : characters)
+          {
+            update_character(character, 1.f / 60.f);
+            build_palette(character.models_, asset.skeleton->invBindPose, palette);
+          }
+          do_not_optimize(palette.data()); });
+      }
+  }
+}
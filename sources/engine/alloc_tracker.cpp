@@ -0,0 +1,213 @@
+#include "alloc_tracker.h"
+#include "log.h"
+#include <imgui/imgui.h>
+#include "ozz/base/memory/allocator.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// one extra slot for allocations outside of any phase
+constexpr int AllocPhaseCount = FramePhaseCount + 1;
+
+struct AtomicAllocStats
+{
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> bytes{0};
+};
+
+static thread_local AllocStats threadStats;
+static AtomicAllocStats currentAllocs[AllocPhaseCount];
+static AllocStats lastAllocs[AllocPhaseCount];
+
+static AllocStats budgets[FramePhaseCount];
+static bool hasBudget[FramePhaseCount];
+static bool budgetsEnabled = false;
+static uint32_t budgetViolations = 0;
+
+// Must not allocate, it runs inside operator new.
+static void track_allocation(size_t size)
+{
+  threadStats.count++;
+  threadStats.bytes += size;
+  AtomicAllocStats &phase = currentAllocs[(int)get_current_phase()];
+  phase.count.fetch_add(1, std::memory_order_relaxed);
+  phase.bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+AllocStats get_thread_alloc_stats()
+{
+  return threadStats;
+}
+
+static void *tracked_alloc(size_t size, size_t alignment)
+{
+  track_allocation(size);
+  if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    return malloc(size ? size : 1);
+#ifdef _WIN32
+  return _aligned_malloc(size ? size : 1, alignment);
+#else
+  // aligned_alloc wants the size to be a multiple of alignment
+  return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void tracked_free(void *block, size_t alignment)
+{
+#ifdef _WIN32
+  if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+  {
+    _aligned_free(block);
+    return;
+  }
+#endif
+  (void)alignment;
+  free(block);
+}
+
+void *operator new(size_t size)
+{
+  if (void *p = tracked_alloc(size, 0))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return tracked_alloc(size, 0);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return tracked_alloc(size, 0);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+  if (void *p = tracked_alloc(size, (size_t)alignment))
+    return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+  return operator new(size, alignment);
+}
+
+void operator delete(void *p) noexcept { tracked_free(p, 0); }
+void operator delete[](void *p) noexcept { tracked_free(p, 0); }
+void operator delete(void *p, size_t) noexcept { tracked_free(p, 0); }
+void operator delete[](void *p, size_t) noexcept { tracked_free(p, 0); }
+void operator delete(void *p, std::align_val_t alignment) noexcept { tracked_free(p, (size_t)alignment); }
+void operator delete[](void *p, std::align_val_t alignment) noexcept { tracked_free(p, (size_t)alignment); }
+void operator delete(void *p, size_t, std::align_val_t alignment) noexcept { tracked_free(p, (size_t)alignment); }
+void operator delete[](void *p, size_t, std::align_val_t alignment) noexcept { tracked_free(p, (size_t)alignment); }
+
+// ozz allocates through its own allocator with malloc, so it's wrapped to be counted too.
+class TrackingOzzAllocator : public ozz::memory::Allocator
+{
+public:
+  explicit TrackingOzzAllocator(ozz::memory::Allocator *backend) : backend(backend) {}
+
+  void *Allocate(size_t _size, size_t _alignment) override
+  {
+    track_allocation(_size);
+    return backend->Allocate(_size, _alignment);
+  }
+
+  void Deallocate(void *_block) override
+  {
+    backend->Deallocate(_block);
+  }
+
+private:
+  ozz::memory::Allocator *backend;
+};
+
+void install_ozz_alloc_tracker()
+{
+  static TrackingOzzAllocator allocator(ozz::memory::default_allocator());
+  ozz::memory::SetDefaulAllocator(&allocator);
+}
+
+void begin_frame_allocs()
+{
+  for (AtomicAllocStats &stats : currentAllocs)
+  {
+    stats.count.store(0, std::memory_order_relaxed);
+    stats.bytes.store(0, std::memory_order_relaxed);
+  }
+}
+
+void end_frame_allocs()
+{
+  for (int i = 0; i < AllocPhaseCount; i++)
+  {
+    lastAllocs[i].count = currentAllocs[i].count.load(std::memory_order_relaxed);
+    lastAllocs[i].bytes = currentAllocs[i].bytes.load(std::memory_order_relaxed);
+  }
+  if (!budgetsEnabled)
+    return;
+  for (int i = 0; i < FramePhaseCount; i++)
+  {
+    if (!hasBudget[i])
+      continue;
+    const AllocStats &stats = lastAllocs[i];
+    if (stats.count > budgets[i].count || stats.bytes > budgets[i].bytes)
+    {
+      budgetViolations++;
+      debug_error("allocation budget of %s exceeded: %llu allocations, %llu bytes (budget %llu, %llu)",
+                  get_phase_name(FramePhase(i)), (unsigned long long)stats.count, (unsigned long long)stats.bytes,
+                  (unsigned long long)budgets[i].count, (unsigned long long)budgets[i].bytes);
+    }
+  }
+}
+
+AllocStats get_phase_allocs(FramePhase phase)
+{
+  return lastAllocs[(int)phase];
+}
+
+void set_alloc_budget(FramePhase phase, AllocStats budget)
+{
+  budgets[(int)phase] = budget;
+  hasBudget[(int)phase] = true;
+}
+
+void enable_alloc_budgets(bool enable)
+{
+  budgetsEnabled = enable;
+}
+
+uint32_t get_alloc_budget_violations()
+{
+  return budgetViolations;
+}
+
+void alloc_tracker_show()
+{
+  if (!ImGui::Begin("Allocations"))
+  {
+    ImGui::End();
+    return;
+  }
+  ImGui::Text("last frame, innermost phase");
+  for (int i = 0; i < AllocPhaseCount; i++)
+  {
+    const char *name = i < FramePhaseCount ? get_phase_name(FramePhase(i)) : "outside phases";
+    const AllocStats &stats = lastAllocs[i];
+    const bool overBudget = i < FramePhaseCount && hasBudget[i] && (stats.count > budgets[i].count || stats.bytes > budgets[i].bytes);
+    ImVec4 color = overBudget ? ImVec4(1, 0.3f, 0.3f, 1) : stats.count > 0 ? ImVec4(1, 0.8f, 0.3f, 1) : ImVec4(0.6f, 0.6f, 0.6f, 1);
+    ImGui::TextColored(color, "%-18s %6llu allocs %10llu bytes", name, (unsigned long long)stats.count, (unsigned long long)stats.bytes);
+  }
+  AllocStats thread = get_thread_alloc_stats();
+  ImGui::Text("main thread total: %llu allocs, %llu bytes", (unsigned long long)thread.count, (unsigned long long)thread.bytes);
+  if (budgetsEnabled)
+    ImGui::Text("budget violations: %u", budgetViolations);
+  ImGui::End();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include "profiler.h"
+
+// Global operator new/delete and the ozz allocator count allocations per thread
+// and per frame phase. An allocation is attributed to the innermost PROFILE_PHASE of its thread.
+struct AllocStats
+{
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+};
+
+// Totals of the calling thread since start.
+AllocStats get_thread_alloc_stats();
+
+// Routes ozz allocations through the tracker, call before creating any ozz object.
+void install_ozz_alloc_tracker();
+
+void begin_frame_allocs();
+void end_frame_allocs();
+// Allocations made during the last finished frame inside phase, FramePhase::Count means outside of any phase.
+AllocStats get_phase_allocs(FramePhase phase);
+
+// Steady state budget: once enable_alloc_budgets was called, every frame which allocates more
+// than the budget in phase is reported and counted as a violation.
+void set_alloc_budget(FramePhase phase, AllocStats budget);
+void enable_alloc_budgets(bool enable);
+uint32_t get_alloc_budget_violations();
+
+void alloc_tracker_show();
+
+// Allocations of the calling thread made since construction, for asserting a code path is allocation free.
+struct AllocScope
+{
+  AllocStats start = get_thread_alloc_stats();
+
+  AllocStats delta() const
+  {
+    AllocStats now = get_thread_alloc_stats();
+    return {now.count - start.count, now.bytes - start.bytes};
+  }
+};
@@ -4,6 +4,16 @@
 #include <imgui/imgui_impl_sdl.h>
 #include <SDL2/SDL.h>
 #include <optick.h>
+#include "profiler.h"
+#include "counters.h"
+#include "alloc_tracker.h"
+#include "memory_stats.h"
+#include "spike_capture.h"
+#include "trace.h"
+#include "startup.h"
+#include "perf_counters.h"
+#include "regression.h"
+#include "parallel.h"
 
 extern void game_init();
 extern void game_update();
@@ -25,7 +35,11 @@ SDLContext context;
 
 void init_application(const char *project_name, int width, int height, bool full_screen)
 {
-  SDL_Init(SDL_INIT_EVERYTHING);
+  STARTUP_SCOPE("init_application");
+  {
+    STARTUP_SCOPE("SDL_Init");
+    SDL_Init(SDL_INIT_EVERYTHING);
+  }
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
@@ -37,15 +51,23 @@ void init_application(const char *project_name, int width, int height, bool full
   size_t window_flags = SDL_WINDOW_OPENGL;
   if (full_screen)
     window_flags |= SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE;
-  context.window = SDL_CreateWindow(project_name, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, (SDL_WindowFlags)(window_flags));
-  context.gl_context = SDL_GL_CreateContext(context.window);
-  SDL_GL_MakeCurrent(context.window, context.gl_context);
-  SDL_GL_SetSwapInterval(0);
+  {
+    STARTUP_SCOPE("create_window");
+    context.window = SDL_CreateWindow(project_name, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, (SDL_WindowFlags)(window_flags));
+    context.gl_context = SDL_GL_CreateContext(context.window);
+    SDL_GL_MakeCurrent(context.window, context.gl_context);
+    SDL_GL_SetSwapInterval(0);
+  }
 
-  if (!gladLoadGLLoader(SDL_GL_GetProcAddress))
   {
-    throw std::runtime_error{"Glad error"};
+    STARTUP_SCOPE("load_gl");
+    if (!gladLoadGLLoader(SDL_GL_GetProcAddress))
+    {
+      throw std::runtime_error{"Glad error"};
+    }
+    OPTICK_GPU_INIT_GL(SDL_GL_GetProcAddress);
   }
+  STARTUP_SCOPE("imgui_init");
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
   ImGui::StyleColorsDark();
@@ -60,11 +82,15 @@ void init_application(const char *project_name, int width, int height, bool full
 
 void close_application()
 {
+  memory_report_at_exit();
+  trace_write();
   close_game();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
   SDL_Quit();
+  counters_close();
+  parallel_close();
   OPTICK_SHUTDOWN();
 }
 
@@ -104,28 +130,44 @@ static bool sdl_event_handler()
 
 void main_loop()
 {
+  bool showFrameTiming = true;
+  bool showCounters = true;
+  bool showAllocations = false;
+  bool showMemory = false;
   start_time();
-  game_init();
+  {
+    STARTUP_SCOPE("game_init");
+    game_init();
+  }
+  startup_finish();
 
   bool running = true;
   while (running)
   {
     OPTICK_FRAME("MainThread");
+    TraceScope frameScope("frame");
     update_time();
+    push_frame_sample(get_delta_time());
+    begin_frame_phases();
+    begin_frame_counters();
+    begin_frame_allocs();
 
 		running = sdl_event_handler();
 
     if (running)
     {
       {
-        OPTICK_EVENT("game_update");
+        PROFILE_EVENT("game_update");
+        PROFILE_PHASE(FramePhase::GameUpdate);
         game_update();
       }
 
       {
-        OPTICK_EVENT("game_render");
+        PROFILE_EVENT("game_render");
+        PROFILE_PHASE(FramePhase::GameRender);
         game_render();
       }
+      regression_capture_frame();
 
       ImGui_ImplOpenGL3_NewFrame();
       ImGui_ImplSDL2_NewFrame(context.window);
@@ -133,22 +175,46 @@ void main_loop()
       {
         if (ImGui::BeginMainMenuBar())
         {
+          ImGui::MenuItem("Frame timing", nullptr, &showFrameTiming);
+          ImGui::MenuItem("Frame counters", nullptr, &showCounters);
+          ImGui::MenuItem("Allocations", nullptr, &showAllocations);
+          ImGui::MenuItem("Memory", nullptr, &showMemory);
           ImGui::EndMainMenuBar();
         }
       }
       {
-        OPTICK_EVENT("imgui_render");
+        PROFILE_EVENT("imgui_render");
+        PROFILE_PHASE(FramePhase::ImguiRender);
         imgui_render();
+        if (showFrameTiming)
+          profiler_show();
+        if (showCounters)
+          counters_show();
+        if (showAllocations)
+          alloc_tracker_show();
+        if (showMemory)
+          memory_show();
+        perf_counters_show();
       }
 
 
       ImGui::Render();
-      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      {
+        PROFILE_GPU_EVENT("imgui_draw");
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      }
 
       {
-        OPTICK_EVENT("SDL_GL_SwapWindow");
+        PROFILE_EVENT("SDL_GL_SwapWindow");
+        PROFILE_PHASE(FramePhase::SwapWindow);
         SDL_GL_SwapWindow(context.window);
+        OPTICK_GPU_FLIP(nullptr);
       }
+      end_frame_phases();
+      end_frame_counters();
+      end_frame_allocs();
+      spike_capture_frame(get_delta_time());
+      running = regression_end_frame();
     }
 	}
 }
@@ -6,4 +6,15 @@ float get_aspect_ratio();
 
 float get_time();
 
-float get_delta_time();
\ No newline at end of file
+float get_delta_time();
+
+// Makes every frame advance by dt seconds instead of the measured time, 0 restores real time.
+void set_fixed_delta_time(float dt);
+
+// Fixed step simulation, decoupled from the render frame rate.
+void set_simulation_rate(float hz);
+float get_simulation_step();
+// Accumulates the frame delta time and returns how many simulation steps are due.
+int update_simulation_time();
+// Fraction of a step left in the accumulator, to interpolate between the last two simulation states.
+float get_simulation_alpha();
@@ -0,0 +1,44 @@
+#include "command_line.h"
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+static std::vector<const char *> arguments;
+
+void init_command_line(int argc, char **argv)
+{
+  arguments.assign(argv + 1, argv + argc);
+}
+
+static int find_argument(const char *name)
+{
+  for (size_t i = 0; i < arguments.size(); i++)
+    if (strcmp(arguments[i], name) == 0)
+      return i;
+  return -1;
+}
+
+bool has_argument(const char *name)
+{
+  return find_argument(name) >= 0;
+}
+
+const char *get_argument(const char *name, const char *default_value)
+{
+  int idx = find_argument(name);
+  if (idx < 0 || idx + 1 >= (int)arguments.size())
+    return default_value;
+  return arguments[idx + 1];
+}
+
+int get_argument(const char *name, int default_value)
+{
+  const char *value = get_argument(name);
+  return value ? atoi(value) : default_value;
+}
+
+float get_argument(const char *name, float default_value)
+{
+  const char *value = get_argument(name);
+  return value ? (float)atof(value) : default_value;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+void init_command_line(int argc, char **argv);
+
+bool has_argument(const char *name);
+const char *get_argument(const char *name, const char *default_value = nullptr);
+int get_argument(const char *name, int default_value);
+float get_argument(const char *name, float default_value);
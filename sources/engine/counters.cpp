@@ -0,0 +1,109 @@
+#include "counters.h"
+#include "command_line.h"
+#include "log.h"
+#include <imgui/imgui.h>
+#include <optick.h>
+#include <atomic>
+#include <cstdio>
+
+static std::atomic<uint64_t> currentCounters[FrameCounterCount];
+static uint64_t lastCounters[FrameCounterCount];
+static uint64_t frameIndex = 0;
+static FILE *csvFile = nullptr;
+
+const char *get_counter_name(FrameCounter counter)
+{
+  switch (counter)
+  {
+    case FrameCounter::DrawCalls: return "draw_calls";
+    case FrameCounter::ProgramBinds: return "program_binds";
+    case FrameCounter::TextureBinds: return "texture_binds";
+    case FrameCounter::BufferUploadBytes: return "buffer_upload_bytes";
+    case FrameCounter::JointsSampled: return "joints_sampled";
+    case FrameCounter::LayersBlended: return "layers_blended";
+    case FrameCounter::CharactersCulled: return "characters_culled";
+    case FrameCounter::CharactersOccluded: return "characters_occluded";
+    default: return "unknown";
+  }
+}
+
+void counters_init()
+{
+  const char *path = get_argument("--counters-csv");
+  if (!path)
+    return;
+  csvFile = fopen(path, "w");
+  if (!csvFile)
+  {
+    debug_error("can't open counters csv %s", path);
+    return;
+  }
+  fprintf(csvFile, "frame");
+  for (int i = 0; i < FrameCounterCount; i++)
+    fprintf(csvFile, ",%s", get_counter_name(FrameCounter(i)));
+  fprintf(csvFile, "\n");
+}
+
+void counters_close()
+{
+  if (csvFile)
+    fclose(csvFile);
+  csvFile = nullptr;
+}
+
+void begin_frame_counters()
+{
+  for (auto &c : currentCounters)
+    c.store(0, std::memory_order_relaxed);
+}
+
+void end_frame_counters()
+{
+  for (int i = 0; i < FrameCounterCount; i++)
+    lastCounters[i] = currentCounters[i].load(std::memory_order_relaxed);
+
+#if USE_OPTICK
+  // OPTICK_TAG keeps one description per call site, so a loop needs its own table
+  static Optick::EventDescription *tags[FrameCounterCount] = {};
+  for (int i = 0; i < FrameCounterCount; i++)
+  {
+    if (!tags[i])
+      tags[i] = Optick::EventDescription::CreateShared(get_counter_name(FrameCounter(i)));
+    Optick::Tag::Attach(*tags[i], lastCounters[i]);
+  }
+#endif
+
+  if (csvFile)
+  {
+    fprintf(csvFile, "%llu", (unsigned long long)frameIndex);
+    for (int i = 0; i < FrameCounterCount; i++)
+      fprintf(csvFile, ",%llu", (unsigned long long)lastCounters[i]);
+    fprintf(csvFile, "\n");
+  }
+  frameIndex++;
+}
+
+void add_counter(FrameCounter counter, uint64_t value)
+{
+  currentCounters[(int)counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t get_counter(FrameCounter counter)
+{
+  return lastCounters[(int)counter];
+}
+
+void counters_show()
+{
+  const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                                 ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+  const ImVec2 displaySize = ImGui::GetIO().DisplaySize;
+  ImGui::SetNextWindowPos(ImVec2(displaySize.x - 10, 30), ImGuiCond_Always, ImVec2(1, 0));
+  ImGui::SetNextWindowBgAlpha(0.35f);
+  if (ImGui::Begin("Frame counters", nullptr, flags))
+  {
+    for (int i = 0; i < FrameCounterCount; i++)
+      ImGui::Text("%-20s %10llu", get_counter_name(FrameCounter(i)), (unsigned long long)lastCounters[i]);
+  }
+  ImGui::End();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+// Work counts of the current frame, they are reset every frame and published by end_frame_counters.
+enum class FrameCounter
+{
+  DrawCalls,
+  ProgramBinds,
+  TextureBinds,
+  BufferUploadBytes,
+  JointsSampled,
+  LayersBlended,
+  CharactersCulled,
+  CharactersOccluded,
+  Count
+};
+
+constexpr int FrameCounterCount = (int)FrameCounter::Count;
+
+const char *get_counter_name(FrameCounter counter);
+
+// Opens the per-frame csv stream when --counters-csv <path> is passed.
+void counters_init();
+void counters_close();
+
+void begin_frame_counters();
+// Publishes the frame totals as Optick tags, to the overlay and to the csv stream.
+void end_frame_counters();
+// Safe to call from any thread.
+void add_counter(FrameCounter counter, uint64_t value = 1);
+// Total of the last finished frame.
+uint64_t get_counter(FrameCounter counter);
+
+void counters_show();
@@ -21,6 +21,7 @@ std::list<Message> &messages_list()
 
 constexpr int messageLen = 1024, timeLen = 20;
 char messageBuf[messageLen], timeBuf[timeLen];
+static bool quietLog = false;
 
 void debug_common(const char *fmt, int status, va_list args)
 {
@@ -53,12 +54,19 @@ void debug_error(const char *fmt, ...)
 
 void debug_log(const char *fmt, ...)
 {
+  if (quietLog)
+    return;
   va_list args;
   va_start(args, fmt);
   debug_common(fmt, 1, args);
   va_end(args);
 }
 
+void debug_set_quiet(bool quiet)
+{
+  quietLog = quiet;
+}
+
 void debug_show()
 {
   std::unique_lock read_write_lock(m);
@@ -5,6 +5,8 @@
 
 void debug_error(const char *format, ...);
 void debug_log(const char *format, ...);
+// Suppresses debug_log output, errors are still reported.
+void debug_set_quiet(bool quiet);
 
 
 
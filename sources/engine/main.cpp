@@ -1,17 +1,37 @@
 #include "application.h"
+#include "command_line.h"
+#include "counters.h"
+#include "alloc_tracker.h"
+#include "memory_stats.h"
+#include "spike_capture.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "regression.h"
+#include "parallel.h"
 
 
 extern void init_application(const char *project_name, int width, int height, bool full_screen);
 extern void close_application();
 extern void main_loop();
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
-  init_application("animations", 2048, 1024, true);
+  install_ozz_alloc_tracker();
+  init_command_line(argc, argv);
+  regression_init();
+  counters_init();
+  memory_budgets_init();
+  spike_capture_init();
+  trace_init();
+  perf_counters_init();
+  parallel_init();
+
+  // regression frames need a fixed back buffer size
+  init_application("animations", 2048, 1024, !regression_enabled());
 
   main_loop();
 
   close_application();
 
-  return 0;
-}
\ No newline at end of file
+  return regression_exit_code();
+}
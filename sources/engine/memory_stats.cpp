@@ -0,0 +1,199 @@
+#include "memory_stats.h"
+#include "command_line.h"
+#include "log.h"
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <vector>
+
+struct TrackedResource
+{
+  std::string name;
+  size_t cpuBytes, gpuBytes;
+};
+
+struct MemoryBudget
+{
+  size_t cpuBytes = 0;
+  size_t gpuBytes = 0;
+  bool warned = false;
+};
+
+static std::mutex memoryMutex;
+static std::map<uintptr_t, TrackedResource> resources[ResourceTypeCount];
+static ResourceMemory totals[ResourceTypeCount];
+static MemoryBudget budgets[ResourceTypeCount];
+
+const char *get_resource_type_name(ResourceType type)
+{
+  switch (type)
+  {
+    case ResourceType::Skeleton: return "skeleton";
+    case ResourceType::Animation: return "animation";
+    case ResourceType::Mesh: return "mesh";
+    case ResourceType::Texture: return "texture";
+    case ResourceType::GPUBuffer: return "gpu_buffer";
+    default: return "unknown";
+  }
+}
+
+static float to_mb(size_t bytes)
+{
+  return bytes / (1024.f * 1024.f);
+}
+
+static bool over_budget(int type)
+{
+  const MemoryBudget &budget = budgets[type];
+  return (budget.cpuBytes > 0 && totals[type].cpuBytes > budget.cpuBytes) ||
+         (budget.gpuBytes > 0 && totals[type].gpuBytes > budget.gpuBytes);
+}
+
+static void check_budget(int type)
+{
+  MemoryBudget &budget = budgets[type];
+  bool over = over_budget(type);
+  if (over && !budget.warned)
+    debug_error("%s memory over budget: cpu %.2f / %.2f MB, gpu %.2f / %.2f MB", get_resource_type_name(ResourceType(type)),
+                to_mb(totals[type].cpuBytes), to_mb(budget.cpuBytes), to_mb(totals[type].gpuBytes), to_mb(budget.gpuBytes));
+  budget.warned = over;
+}
+
+void track_resource(ResourceType type, uintptr_t id, const std::string &name, size_t cpu_bytes, size_t gpu_bytes)
+{
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  int t = (int)type;
+  auto [it, inserted] = resources[t].try_emplace(id, TrackedResource{name, 0, 0});
+  if (inserted)
+    totals[t].count++;
+  totals[t].cpuBytes += cpu_bytes - it->second.cpuBytes;
+  totals[t].gpuBytes += gpu_bytes - it->second.gpuBytes;
+  it->second = {name, cpu_bytes, gpu_bytes};
+  check_budget(t);
+}
+
+void untrack_resource(ResourceType type, uintptr_t id)
+{
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  int t = (int)type;
+  auto it = resources[t].find(id);
+  if (it == resources[t].end())
+    return;
+  totals[t].count--;
+  totals[t].cpuBytes -= it->second.cpuBytes;
+  totals[t].gpuBytes -= it->second.gpuBytes;
+  resources[t].erase(it);
+  check_budget(t);
+}
+
+ResourceMemory get_resource_memory(ResourceType type)
+{
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  return totals[(int)type];
+}
+
+void set_memory_budget(ResourceType type, size_t cpu_bytes, size_t gpu_bytes)
+{
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  budgets[(int)type].cpuBytes = cpu_bytes;
+  budgets[(int)type].gpuBytes = gpu_bytes;
+  budgets[(int)type].warned = false;
+  check_budget((int)type);
+}
+
+void memory_budgets_init()
+{
+  for (int t = 0; t < ResourceTypeCount; t++)
+  {
+    std::string prefix = std::string("--budget-") + get_resource_type_name(ResourceType(t));
+    float cpuMb = get_argument((prefix + "-cpu-mb").c_str(), 0.f);
+    float gpuMb = get_argument((prefix + "-gpu-mb").c_str(), 0.f);
+    if (cpuMb > 0.f || gpuMb > 0.f)
+      set_memory_budget(ResourceType(t), size_t(cpuMb * 1024 * 1024), size_t(gpuMb * 1024 * 1024));
+  }
+}
+
+// largest assets first
+static std::vector<const TrackedResource *> sorted_resources(int type)
+{
+  std::vector<const TrackedResource *> sorted;
+  for (const auto &[id, resource] : resources[type])
+    sorted.push_back(&resource);
+  std::sort(sorted.begin(), sorted.end(), [](const TrackedResource *a, const TrackedResource *b)
+            { return a->cpuBytes + a->gpuBytes > b->cpuBytes + b->gpuBytes; });
+  return sorted;
+}
+
+bool dump_memory_report(const char *path)
+{
+  FILE *file = fopen(path, "w");
+  if (!file)
+  {
+    debug_error("can't write memory report %s", path);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  fprintf(file, "%-12s %6s %12s %12s %12s %12s\n", "type", "count", "cpu_bytes", "gpu_bytes", "cpu_budget", "gpu_budget");
+  for (int t = 0; t < ResourceTypeCount; t++)
+    fprintf(file, "%-12s %6d %12zu %12zu %12zu %12zu%s\n", get_resource_type_name(ResourceType(t)), totals[t].count,
+            totals[t].cpuBytes, totals[t].gpuBytes, budgets[t].cpuBytes, budgets[t].gpuBytes, over_budget(t) ? " OVER BUDGET" : "");
+  for (int t = 0; t < ResourceTypeCount; t++)
+  {
+    fprintf(file, "\n[%s]\n", get_resource_type_name(ResourceType(t)));
+    for (const TrackedResource *resource : sorted_resources(t))
+      fprintf(file, "%12zu %12zu %s\n", resource->cpuBytes, resource->gpuBytes, resource->name.c_str());
+  }
+  fclose(file);
+  debug_log("memory report written to %s", path);
+  return true;
+}
+
+void memory_report_at_exit()
+{
+  if (const char *path = get_argument("--memory-report"))
+    dump_memory_report(path);
+}
+
+void memory_show()
+{
+  if (!ImGui::Begin("Memory"))
+  {
+    ImGui::End();
+    return;
+  }
+  if (ImGui::Button("Dump report"))
+    dump_memory_report("memory_report.txt");
+
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  ResourceMemory sum;
+  for (int t = 0; t < ResourceTypeCount; t++)
+  {
+    const ResourceMemory &total = totals[t];
+    sum.cpuBytes += total.cpuBytes;
+    sum.gpuBytes += total.gpuBytes;
+    const MemoryBudget &budget = budgets[t];
+    if (over_budget(t))
+      ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1, 0.3f, 0.3f, 1));
+    char label[128];
+    snprintf(label, sizeof(label), "%-10s x%-4d cpu %8.2f MB  gpu %8.2f MB###%d", get_resource_type_name(ResourceType(t)), total.count,
+             to_mb(total.cpuBytes), to_mb(total.gpuBytes), t);
+    bool open = ImGui::TreeNode(label);
+    if (over_budget(t))
+      ImGui::PopStyleColor();
+    if (budget.cpuBytes > 0)
+      ImGui::ProgressBar(float(total.cpuBytes) / budget.cpuBytes, ImVec2(-1, 0), "cpu budget");
+    if (budget.gpuBytes > 0)
+      ImGui::ProgressBar(float(total.gpuBytes) / budget.gpuBytes, ImVec2(-1, 0), "gpu budget");
+    if (open)
+    {
+      for (const TrackedResource *resource : sorted_resources(t))
+        ImGui::Text("cpu %8.1f KB  gpu %8.1f KB  %s", resource->cpuBytes / 1024.f, resource->gpuBytes / 1024.f, resource->name.c_str());
+      ImGui::TreePop();
+    }
+  }
+  ImGui::Separator();
+  ImGui::Text("total cpu %.2f MB, gpu %.2f MB", to_mb(sum.cpuBytes), to_mb(sum.gpuBytes));
+  ImGui::End();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// CPU and GL memory accounting per resource type and per asset.
+enum class ResourceType
+{
+  Skeleton,
+  Animation,
+  Mesh,
+  Texture,
+  GPUBuffer,
+  Count
+};
+
+constexpr int ResourceTypeCount = (int)ResourceType::Count;
+
+const char *get_resource_type_name(ResourceType type);
+
+struct ResourceMemory
+{
+  size_t cpuBytes = 0;
+  size_t gpuBytes = 0;
+  int count = 0;
+};
+
+// Registers the resource or updates its sizes, id is unique within a type (object address or GL name).
+void track_resource(ResourceType type, uintptr_t id, const std::string &name, size_t cpu_bytes, size_t gpu_bytes);
+void untrack_resource(ResourceType type, uintptr_t id);
+ResourceMemory get_resource_memory(ResourceType type);
+
+// Soft budgets only warn, zero means no budget.
+// Read from --budget-<type>-cpu-mb and --budget-<type>-gpu-mb, e.g. --budget-animation-cpu-mb 64.
+void set_memory_budget(ResourceType type, size_t cpu_bytes, size_t gpu_bytes);
+void memory_budgets_init();
+
+bool dump_memory_report(const char *path);
+// Writes the report to --memory-report <path> if it was passed.
+void memory_report_at_exit();
+
+void memory_show();
@@ -0,0 +1,104 @@
+#include "parallel.h"
+#include "command_line.h"
+#include "log.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static struct
+{
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wake, done;
+  const std::function<void(int, int)> *body = nullptr;
+  int count = 0;
+  int grain = 1;
+  std::atomic<int> next = 0;
+  // workers which didn't finish the current job yet
+  int active = 0;
+  uint64_t generation = 0;
+  bool quit = false;
+} pool;
+
+static void run_chunks()
+{
+  for (int begin = pool.next.fetch_add(pool.grain); begin < pool.count; begin = pool.next.fetch_add(pool.grain))
+    (*pool.body)(begin, std::min(begin + pool.grain, pool.count));
+}
+
+static void worker_loop()
+{
+  OPTICK_THREAD("Worker");
+  trace_thread_name("worker");
+  uint64_t seen = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(pool.mutex);
+      pool.wake.wait(lock, [&] { return pool.quit || pool.generation != seen; });
+      if (pool.quit)
+        return;
+      seen = pool.generation;
+    }
+    run_chunks();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (--pool.active == 0)
+      pool.done.notify_one();
+  }
+}
+
+void parallel_init()
+{
+  const int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+  const int workers = std::max(0, get_argument("--worker-threads", hardware - 1));
+  for (int i = 0; i < workers; i++)
+    pool.threads.emplace_back(worker_loop);
+  debug_log("parallel_for runs on %d worker threads", workers);
+}
+
+void parallel_close()
+{
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.quit = true;
+  }
+  pool.wake.notify_all();
+  for (std::thread &thread : pool.threads)
+    thread.join();
+  pool.threads.clear();
+}
+
+int get_worker_count()
+{
+  return pool.threads.size();
+}
+
+void parallel_for(int count, int grain, const std::function<void(int, int)> &body)
+{
+  if (count <= 0)
+    return;
+  grain = std::max(grain, 1);
+  if (pool.threads.empty() || count <= grain)
+  {
+    for (int begin = 0; begin < count; begin += grain)
+      body(begin, std::min(begin + grain, count));
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.body = &body;
+    pool.count = count;
+    pool.grain = grain;
+    pool.next = 0;
+    pool.active = pool.threads.size();
+    pool.generation++;
+  }
+  pool.wake.notify_all();
+  run_chunks();
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  pool.done.wait(lock, [] { return pool.active == 0; });
+}
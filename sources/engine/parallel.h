@@ -0,0 +1,11 @@
+#pragma once
+#include <functional>
+
+// Persistent worker threads, started by parallel_init with --worker-threads <n> (hardware threads - 1 by default).
+void parallel_init();
+void parallel_close();
+int get_worker_count();
+
+// Calls body(begin, end) for chunks of at most grain items of [0, count), the calling thread takes chunks too
+// and the call returns when all of them are done. Not reentrant, body must not call parallel_for.
+void parallel_for(int count, int grain, const std::function<void(int, int)> &body);
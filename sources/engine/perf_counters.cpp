@@ -0,0 +1,189 @@
+#include "perf_counters.h"
+#include "command_line.h"
+#include "log.h"
+#include <imgui/imgui.h>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct PerfCounterDesc
+{
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+};
+
+struct PerfPhaseTotals
+{
+  uint64_t values[PerfCounterCount] = {};
+  uint64_t characters = 0, joints = 0, scopes = 0;
+};
+
+static bool perfEnabled = false;
+static bool perfHardware = false;
+static std::thread::id perfThread;
+static const char *counterNames[PerfCounterCount] = {};
+static int counterFds[PerfCounterCount] = {-1, -1, -1, -1};
+// position of each counter in the group read, counters are read in one syscall through the first one
+static int groupSlot[PerfCounterCount] = {-1, -1, -1, -1};
+static int groupSize = 0;
+static PerfPhaseTotals perfTotals[PerfPhaseCount];
+
+static const char *get_perf_phase_name(PerfPhase phase)
+{
+  switch (phase)
+  {
+    case PerfPhase::Update: return "update";
+    case PerfPhase::Palette: return "palette";
+    case PerfPhase::Render: return "render";
+    default: return "unknown";
+  }
+}
+
+#ifdef __linux__
+static const PerfCounterDesc hardwareCounters[PerfCounterCount] = {
+  {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static const PerfCounterDesc softwareCounters[PerfCounterCount] = {
+  {"task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+  {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+  {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+  {"cpu_migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+};
+
+static int open_counter(const PerfCounterDesc &desc, int group_fd)
+{
+  perf_event_attr attr = {};
+  attr.size = sizeof(attr);
+  attr.type = desc.type;
+  attr.config = desc.config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  // counts the calling thread on any cpu
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static bool open_counters(const PerfCounterDesc (&descs)[PerfCounterCount], bool require_all)
+{
+  groupSize = 0;
+  for (int i = 0; i < PerfCounterCount; i++)
+  {
+    counterNames[i] = descs[i].name;
+    counterFds[i] = open_counter(descs[i], i == 0 ? -1 : counterFds[0]);
+    groupSlot[i] = counterFds[i] >= 0 ? groupSize++ : -1;
+    if (counterFds[0] < 0)
+      break;
+  }
+  // cycles and instructions are needed for IPC, cache and branch misses may be missing on some cpus
+  bool ok = require_all ? groupSize == PerfCounterCount : counterFds[0] >= 0 && counterFds[1] >= 0;
+  if (!ok)
+  {
+    for (int i = 0; i < PerfCounterCount; i++)
+    {
+      if (counterFds[i] >= 0)
+        close(counterFds[i]);
+      counterFds[i] = groupSlot[i] = -1;
+    }
+    groupSize = 0;
+  }
+  return ok;
+}
+#endif
+
+void perf_counters_init()
+{
+  if (!has_argument("--perf-counters"))
+    return;
+#ifdef __linux__
+  if (open_counters(hardwareCounters, false))
+    perfHardware = true;
+  else if (!open_counters(softwareCounters, true))
+  {
+    debug_error("perf_event_open failed, check /proc/sys/kernel/perf_event_paranoid");
+    return;
+  }
+  perfEnabled = true;
+  perfThread = std::this_thread::get_id();
+  debug_log("perf counters: %s", perfHardware ? "hardware" : "software fallback");
+#else
+  debug_error("--perf-counters needs linux perf_event_open");
+#endif
+}
+
+bool perf_counters_enabled()
+{
+  return perfEnabled;
+}
+
+void perf_counters_read(uint64_t (&values)[PerfCounterCount])
+{
+  for (uint64_t &value : values)
+    value = 0;
+#ifdef __linux__
+  if (!perfEnabled || std::this_thread::get_id() != perfThread)
+    return;
+  // PERF_FORMAT_GROUP layout: counter count, then values in the order counters joined the group
+  uint64_t group[1 + PerfCounterCount];
+  const ssize_t size = sizeof(uint64_t) * (1 + groupSize);
+  if (read(counterFds[0], group, size) != size)
+    return;
+  for (int i = 0; i < PerfCounterCount; i++)
+    if (groupSlot[i] >= 0)
+      values[i] = group[1 + groupSlot[i]];
+#endif
+}
+
+void perf_counters_add(PerfPhase phase, const uint64_t (&begin)[PerfCounterCount], const uint64_t (&end)[PerfCounterCount], int characters, int joints)
+{
+  if (std::this_thread::get_id() != perfThread)
+    return;
+  PerfPhaseTotals &totals = perfTotals[(int)phase];
+  for (int i = 0; i < PerfCounterCount; i++)
+    totals.values[i] += end[i] - begin[i];
+  totals.characters += characters;
+  totals.joints += joints;
+  totals.scopes++;
+}
+
+void perf_counters_show()
+{
+  if (!perfEnabled)
+    return;
+  if (!ImGui::Begin("Hardware counters"))
+  {
+    ImGui::End();
+    return;
+  }
+  ImGui::Text("%s counters, totals since reset", perfHardware ? "hardware" : "software");
+  ImGui::SameLine();
+  if (ImGui::Button("Reset"))
+    for (PerfPhaseTotals &totals : perfTotals)
+      totals = {};
+  for (int p = 0; p < PerfPhaseCount; p++)
+  {
+    const PerfPhaseTotals &totals = perfTotals[p];
+    if (totals.scopes == 0)
+      continue;
+    ImGui::Separator();
+    ImGui::Text("%s: %llu characters, %llu joints", get_perf_phase_name(PerfPhase(p)),
+                (unsigned long long)totals.characters, (unsigned long long)totals.joints);
+    if (perfHardware && totals.values[0] > 0)
+      ImGui::Text("  IPC %.2f", double(totals.values[1]) / totals.values[0]);
+    const double characters = totals.characters ? totals.characters : 1;
+    const double joints = totals.joints ? totals.joints : 1;
+    for (int i = 0; i < PerfCounterCount; i++)
+      if (counterFds[i] >= 0)
+        ImGui::Text("  %-16s %12.1f / character %10.2f / joint", counterNames[i], totals.values[i] / characters, totals.values[i] / joints);
+  }
+  ImGui::End();
+}
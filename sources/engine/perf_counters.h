@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+// Optional hardware counters around engine phases, Linux perf_event_open only, enabled with --perf-counters.
+// Falls back to software counters when the hardware ones can't be opened (VMs, perf_event_paranoid).
+enum class PerfPhase
+{
+  Update,
+  Palette,
+  Render, // includes Palette
+  Count
+};
+
+constexpr int PerfPhaseCount = (int)PerfPhase::Count;
+constexpr int PerfCounterCount = 4;
+
+void perf_counters_init();
+bool perf_counters_enabled();
+// Raw counter values of the calling thread, zeros when disabled or called off the main thread.
+void perf_counters_read(uint64_t (&values)[PerfCounterCount]);
+void perf_counters_add(PerfPhase phase, const uint64_t (&begin)[PerfCounterCount], const uint64_t (&end)[PerfCounterCount], int characters, int joints);
+void perf_counters_show();
+
+struct PerfScope
+{
+  PerfPhase phase;
+  int characters, joints;
+  uint64_t begin[PerfCounterCount];
+
+  PerfScope(PerfPhase phase, int characters, int joints) : phase(phase), characters(characters), joints(joints)
+  {
+    if (perf_counters_enabled())
+      perf_counters_read(begin);
+  }
+  ~PerfScope()
+  {
+    if (!perf_counters_enabled())
+      return;
+    uint64_t end[PerfCounterCount];
+    perf_counters_read(end);
+    perf_counters_add(phase, begin, end, characters, joints);
+  }
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+// SystemTap compatible USDT probes under the "animations" provider, for bpftrace/perf/stap, e.g.
+//   bpftrace -e 'usdt:./animations:animations:update_character_entry { @start[tid] = nsecs; }'
+// Built with -DUSE_USDT=ON (needs sys/sdt.h from systemtap-sdt-dev), otherwise they compile to nothing.
+// A probe is a single nop until a tracer attaches, but its arguments are still computed,
+// so pass values which are already at hand.
+#if defined(USE_USDT) && USE_USDT && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PROBE(name) DTRACE_PROBE(animations, name)
+#define PROBE1(name, a) DTRACE_PROBE1(animations, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(animations, name, a, b)
+#else
+#define PROBE(name) ((void)0)
+#define PROBE1(name, a) ((void)sizeof(a))
+#define PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#endif
@@ -0,0 +1,168 @@
+#include "profiler.h"
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <vector>
+
+static float currentTimes[FramePhaseCount];
+static float lastTimes[FramePhaseCount];
+static thread_local FramePhase currentPhase = FramePhase::Count;
+
+const char *get_phase_name(FramePhase phase)
+{
+  switch (phase)
+  {
+    case FramePhase::GameUpdate: return "game_update";
+    case FramePhase::UpdateCharacter: return "update_character";
+    case FramePhase::GameRender: return "game_render";
+    case FramePhase::RenderCharacter: return "render_character";
+    case FramePhase::ImguiRender: return "imgui_render";
+    case FramePhase::SwapWindow: return "SDL_GL_SwapWindow";
+    default: return "unknown";
+  }
+}
+
+void begin_frame_phases()
+{
+  for (float &t : currentTimes)
+    t = 0.f;
+}
+
+void end_frame_phases()
+{
+  for (int i = 0; i < FramePhaseCount; i++)
+    lastTimes[i] = currentTimes[i];
+}
+
+void add_phase_time(FramePhase phase, float ms)
+{
+  currentTimes[(int)phase] += ms;
+}
+
+float get_phase_time(FramePhase phase)
+{
+  return lastTimes[(int)phase];
+}
+
+FramePhase get_current_phase()
+{
+  return currentPhase;
+}
+
+FramePhase set_current_phase(FramePhase phase)
+{
+  FramePhase prev = currentPhase;
+  currentPhase = phase;
+  return prev;
+}
+
+struct FrameSample
+{
+  float frameTime; // ms
+  float phases[FramePhaseCount];
+};
+
+// Single producer ring, the writer publishes a sample by bumping written after filling it.
+constexpr uint32_t FrameHistorySize = 1024;
+static FrameSample frameHistory[FrameHistorySize];
+static std::atomic<uint32_t> framesWritten{0};
+
+void push_frame_sample(float frame_time)
+{
+  if (frame_time <= 0.f)
+    return;
+  uint32_t idx = framesWritten.load(std::memory_order_relaxed);
+  FrameSample &sample = frameHistory[idx % FrameHistorySize];
+  sample.frameTime = frame_time * 1000.f;
+  for (int i = 0; i < FramePhaseCount; i++)
+    sample.phases[i] = lastTimes[i];
+  framesWritten.store(idx + 1, std::memory_order_release);
+}
+
+struct SeriesStats
+{
+  float p50, p95, p99, max;
+};
+
+static SeriesStats get_stats(std::vector<float> values)
+{
+  if (values.empty())
+    return {};
+  auto percentile = [&](float p)
+  {
+    auto it = values.begin() + std::min<size_t>(values.size() - 1, size_t(p * values.size()));
+    std::nth_element(values.begin(), it, values.end());
+    return *it;
+  };
+  SeriesStats stats;
+  stats.p50 = percentile(0.5f);
+  stats.p95 = percentile(0.95f);
+  stats.p99 = percentile(0.99f);
+  stats.max = *std::max_element(values.begin(), values.end());
+  return stats;
+}
+
+static void show_series(const char *name, const std::vector<float> &values, const SeriesStats &stats)
+{
+  const int Buckets = 32;
+  float histogram[Buckets] = {};
+  float range = std::max(stats.max, 0.001f);
+  for (float v : values)
+    histogram[std::min(int(v / range * Buckets), Buckets - 1)] += 1.f;
+
+  ImGui::PushID(name);
+  ImGui::Text("%-18s p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms", name, stats.p50, stats.p95, stats.p99, stats.max);
+  ImGui::PlotLines("##history", values.data(), values.size(), 0, nullptr, 0.f, stats.p99 * 1.5f, ImVec2(0, 40));
+  ImGui::SameLine();
+  ImGui::PlotHistogram("##histogram", histogram, Buckets, 0, nullptr, 0.f, FLT_MAX, ImVec2(0, 40));
+  ImGui::PopID();
+}
+
+void profiler_show()
+{
+  if (!ImGui::Begin("Frame timing"))
+  {
+    ImGui::End();
+    return;
+  }
+  uint32_t written = framesWritten.load(std::memory_order_acquire);
+  uint32_t count = std::min(written, FrameHistorySize);
+  std::vector<float> frameTimes(count);
+  std::vector<float> phaseTimes[FramePhaseCount];
+  int worst = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const FrameSample &sample = frameHistory[(written - count + i) % FrameHistorySize];
+    frameTimes[i] = sample.frameTime;
+    if (sample.frameTime > frameTimes[worst])
+      worst = i;
+    for (int p = 0; p < FramePhaseCount; p++)
+      phaseTimes[p].push_back(sample.phases[p]);
+  }
+  ImGui::Text("last %u frames", count);
+  show_series("frame", frameTimes, get_stats(frameTimes));
+  SeriesStats phaseStats[FramePhaseCount];
+  for (int p = 0; p < FramePhaseCount; p++)
+  {
+    phaseStats[p] = get_stats(phaseTimes[p]);
+    show_series(get_phase_name(FramePhase(p)), phaseTimes[p], phaseStats[p]);
+  }
+
+  if (count > 0)
+  {
+    // the worst frame is attributed to the phase which exceeded its median the most
+    ImGui::Separator();
+    ImGui::Text("worst frame %u frames ago: %.2f ms", count - 1 - worst, frameTimes[worst]);
+    int culprit = 0;
+    for (int p = 0; p < FramePhaseCount; p++)
+    {
+      float excess = phaseTimes[p][worst] - phaseStats[p].p50;
+      if (excess > phaseTimes[culprit][worst] - phaseStats[culprit].p50)
+        culprit = p;
+      ImGui::Text("  %-18s %6.2f ms (median %6.2f)", get_phase_name(FramePhase(p)), phaseTimes[p][worst], phaseStats[p].p50);
+    }
+    ImGui::Text("attributed to %s", get_phase_name(FramePhase(culprit)));
+  }
+  ImGui::End();
+}
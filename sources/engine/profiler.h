@@ -0,0 +1,53 @@
+#pragma once
+#include <chrono>
+
+enum class FramePhase
+{
+  GameUpdate,
+  UpdateCharacter,
+  GameRender,
+  RenderCharacter,
+  ImguiRender,
+  SwapWindow,
+  Count
+};
+
+constexpr int FramePhaseCount = (int)FramePhase::Count;
+
+const char *get_phase_name(FramePhase phase);
+
+// Phase times are accumulated during the frame and published by end_frame_phases.
+void begin_frame_phases();
+void end_frame_phases();
+void add_phase_time(FramePhase phase, float ms);
+// Milliseconds spent in phase during the last finished frame.
+float get_phase_time(FramePhase phase);
+
+// Adds the finished frame to the rolling history, frame_time is the delta time in seconds.
+void push_frame_sample(float frame_time);
+// Frame timing window with rolling history, histograms, percentiles and worst frame attribution.
+void profiler_show();
+
+// Innermost phase of the calling thread, FramePhase::Count outside of any phase.
+FramePhase get_current_phase();
+// Makes phase current for the calling thread and returns the previous one.
+FramePhase set_current_phase(FramePhase phase);
+
+struct PhaseScope
+{
+  using clock = std::chrono::high_resolution_clock;
+  FramePhase phase, parent;
+  clock::time_point start;
+
+  PhaseScope(FramePhase phase) : phase(phase), parent(set_current_phase(phase)), start(clock::now()) {}
+  ~PhaseScope()
+  {
+    std::chrono::duration<float, std::milli> d = clock::now() - start;
+    add_phase_time(phase, d.count());
+    set_current_phase(parent);
+  }
+};
+
+#define PROFILE_PHASE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_PHASE_CONCAT(a, b) PROFILE_PHASE_CONCAT_IMPL(a, b)
+#define PROFILE_PHASE(phase) PhaseScope PROFILE_PHASE_CONCAT(phase_scope_, __LINE__)(phase)
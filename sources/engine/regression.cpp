@@ -0,0 +1,237 @@
+#include "regression.h"
+#include "command_line.h"
+#include "profiler.h"
+#include "alloc_tracker.h"
+#include "log.h"
+#include "application.h"
+#include <glad/glad.h>
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct RegressionGate
+{
+  bool enabled = false;
+  bool update = false;
+  std::string directory;
+  int frames = 240;
+  int warmup = 30;
+  int captures = 4;
+  float timeThreshold = 0.2f;   // relative slowdown which fails the gate
+  float minTimeDelta = 0.05f;   // ms, slowdowns below it are noise
+  float pixelTolerance = 0.01f; // fraction of pixels allowed to differ
+  int pixelThreshold = 8;       // per channel difference counted as mismatch
+  bool allocBudget = false;     // character update and render must not allocate after warmup
+
+  int frame = 0;
+  bool failed = false;
+  std::vector<float> phaseSamples[FramePhaseCount];
+};
+
+static RegressionGate gate;
+
+bool regression_enabled()
+{
+  return gate.enabled;
+}
+
+void regression_init()
+{
+  gate.enabled = has_argument("--regression");
+  if (!gate.enabled)
+    return;
+  gate.update = has_argument("--regression-update");
+  gate.directory = get_argument("--regression-dir", "regression");
+  gate.frames = get_argument("--regression-frames", gate.frames);
+  gate.warmup = std::min(get_argument("--regression-warmup", gate.warmup), gate.frames - 1);
+  gate.captures = get_argument("--regression-captures", gate.captures);
+  gate.timeThreshold = get_argument("--regression-threshold", gate.timeThreshold);
+  gate.pixelTolerance = get_argument("--regression-tolerance", gate.pixelTolerance);
+  gate.allocBudget = has_argument("--regression-alloc-budget");
+  if (gate.allocBudget)
+  {
+    set_alloc_budget(FramePhase::UpdateCharacter, {});
+    set_alloc_budget(FramePhase::RenderCharacter, {});
+  }
+  set_fixed_delta_time(1.f / 60.f);
+  std::filesystem::create_directories(gate.directory);
+  debug_log("regression gate: %d frames, %s %s", gate.frames, gate.update ? "updating" : "comparing with", gate.directory.c_str());
+}
+
+static bool is_capture_frame(int frame)
+{
+  if (gate.captures <= 0)
+    return false;
+  int step = std::max(gate.frames / gate.captures, 1);
+  return frame % step == step - 1;
+}
+
+static void write_ppm(const std::string &path, const std::vector<unsigned char> &pixels, int w, int h)
+{
+  std::ofstream file(path, std::ios::binary);
+  file << "P6\n" << w << " " << h << "\n255\n";
+  // glReadPixels returns rows bottom-up
+  for (int y = h - 1; y >= 0; y--)
+    file.write((const char *)pixels.data() + y * w * 3, w * 3);
+}
+
+static void compare_frame(const std::string &path, const std::vector<unsigned char> &pixels, int w, int h)
+{
+  int gw, gh, ch;
+  unsigned char *golden = stbi_load(path.c_str(), &gw, &gh, &ch, 3);
+  if (!golden)
+  {
+    debug_error("regression: no golden frame %s", path.c_str());
+    gate.failed = true;
+    return;
+  }
+  if (gw != w || gh != h)
+  {
+    debug_error("regression: %s is %dx%d, frame is %dx%d", path.c_str(), gw, gh, w, h);
+    gate.failed = true;
+    stbi_image_free(golden);
+    return;
+  }
+  // goldens are stored top-down, glReadPixels rows are bottom-up; flipped here so the global stb state stays untouched
+  int mismatched = 0;
+  for (int y = 0; y < h; y++)
+    for (int x = 0; x < w; x++)
+    {
+      const unsigned char *expected = golden + ((h - 1 - y) * w + x) * 3;
+      const unsigned char *actual = pixels.data() + (y * w + x) * 3;
+      for (int c = 0; c < 3; c++)
+        if (abs(int(expected[c]) - int(actual[c])) > gate.pixelThreshold)
+        {
+          mismatched++;
+          break;
+        }
+    }
+  stbi_image_free(golden);
+  float fraction = float(mismatched) / (w * h);
+  if (fraction > gate.pixelTolerance)
+  {
+    std::string actualPath = path.substr(0, path.size() - 4) + "_actual.ppm";
+    write_ppm(actualPath, pixels, w, h);
+    debug_error("regression: %s differs in %.2f%% pixels, see %s", path.c_str(), fraction * 100.f, actualPath.c_str());
+    gate.failed = true;
+  }
+}
+
+void regression_capture_frame()
+{
+  if (!gate.enabled || !is_capture_frame(gate.frame))
+    return;
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  int w = viewport[2], h = viewport[3];
+  std::vector<unsigned char> pixels(w * h * 3);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+  std::string path = gate.directory + "/frame_" + std::to_string(gate.frame) + ".ppm";
+  if (gate.update)
+    write_ppm(path, pixels, w, h);
+  else
+    compare_frame(path, pixels, w, h);
+}
+
+static float median(std::vector<float> samples)
+{
+  if (samples.empty())
+    return 0.f;
+  auto mid = samples.begin() + samples.size() / 2;
+  std::nth_element(samples.begin(), mid, samples.end());
+  return *mid;
+}
+
+static void write_baseline(const std::string &path, const float *times)
+{
+  std::ofstream file(path);
+  file << "{\n  \"frames\": " << gate.frames - gate.warmup << ",\n  \"phases\": {\n";
+  for (int i = 0; i < FramePhaseCount; i++)
+    file << "    \"" << get_phase_name(FramePhase(i)) << "\": " << times[i] << (i + 1 < FramePhaseCount ? ",\n" : "\n");
+  file << "  }\n}\n";
+}
+
+// Baseline is written by write_baseline, so it is enough to look up "name": value pairs.
+static bool read_baseline_value(const std::string &json, const char *name, float &value)
+{
+  std::string key = std::string("\"") + name + "\":";
+  size_t pos = json.find(key);
+  if (pos == std::string::npos)
+    return false;
+  value = strtof(json.c_str() + pos + key.size(), nullptr);
+  return true;
+}
+
+static void check_timings()
+{
+  float times[FramePhaseCount];
+  for (int i = 0; i < FramePhaseCount; i++)
+    times[i] = median(gate.phaseSamples[i]);
+
+  std::string path = gate.directory + "/baseline.json";
+  if (gate.update)
+  {
+    write_baseline(path, times);
+    return;
+  }
+  std::ifstream file(path);
+  if (!file)
+  {
+    debug_error("regression: no timing baseline %s", path.c_str());
+    gate.failed = true;
+    return;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string json = buffer.str();
+  for (int i = 0; i < FramePhaseCount; i++)
+  {
+    const char *name = get_phase_name(FramePhase(i));
+    float baseline;
+    if (!read_baseline_value(json, name, baseline))
+      continue;
+    bool slower = times[i] > baseline * (1.f + gate.timeThreshold) && times[i] - baseline > gate.minTimeDelta;
+    if (slower)
+    {
+      debug_error("regression: %s %.3f ms, baseline %.3f ms (+%.0f%%)", name, times[i], baseline, (times[i] / baseline - 1.f) * 100.f);
+      gate.failed = true;
+    }
+    else
+      debug_log("regression: %s %.3f ms, baseline %.3f ms", name, times[i], baseline);
+  }
+}
+
+bool regression_end_frame()
+{
+  if (!gate.enabled)
+    return true;
+  if (gate.frame >= gate.warmup)
+    for (int i = 0; i < FramePhaseCount; i++)
+      gate.phaseSamples[i].push_back(get_phase_time(FramePhase(i)));
+
+  gate.frame++;
+  if (gate.allocBudget && gate.frame == gate.warmup)
+    enable_alloc_budgets(true);
+  if (gate.frame < gate.frames)
+    return true;
+
+  check_timings();
+  if (get_alloc_budget_violations() > 0)
+  {
+    debug_error("regression: %u frames exceeded allocation budgets", get_alloc_budget_violations());
+    gate.failed = true;
+  }
+  debug_log("regression gate %s", gate.update ? "updated" : gate.failed ? "FAILED" : "passed");
+  return false;
+}
+
+int regression_exit_code()
+{
+  return gate.failed ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Golden-frame and per-phase timing gate, enabled with --regression.
+// Renders a fixed number of frames with a fixed time step, compares captured frames against
+// golden images and median phase timings against a baseline json.
+// --regression-update rewrites goldens and baseline instead of comparing.
+// --regression-alloc-budget also fails the gate if character update or render allocate after warmup.
+bool regression_enabled();
+void regression_init();
+void regression_capture_frame();
+// Returns false when the gate has rendered all its frames.
+bool regression_end_frame();
+int regression_exit_code();
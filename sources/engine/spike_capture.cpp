@@ -0,0 +1,196 @@
+#include "spike_capture.h"
+#include "command_line.h"
+#include "log.h"
+#include "profiler.h"
+#include <optick.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Restarting a segment relies on Core::Activate dropping the frames of the stopped capture, see optick_core.cpp.
+#if USE_OPTICK && !OPTICK_CLEAR_FRAMES_ON_START
+#error spike capture needs the OPTICK_CLEAR_FRAMES_ON_START patch of the vendored Optick
+#endif
+
+enum class SpikeState
+{
+  Idle,
+  Recording,
+  AfterSpike,
+};
+
+struct FrameSummary
+{
+  float frameMs;
+  float phaseMs[FramePhaseCount];
+};
+
+struct SpikeCapture
+{
+  bool enabled = false;
+  float thresholdMs = 0.f;   // absolute threshold, 0 disables it
+  float medianFactor = 3.f;  // relative threshold, 0 disables it
+  int framesBefore = 60;
+  int framesAfter = 30;
+  int warmup = 60;           // loading hitches are not interesting
+  int maxCaptures = 5;
+  std::string directory;
+
+  SpikeState state = SpikeState::Idle;
+  int frame = 0;
+  int segmentFrames = 0;
+  int remaining = 0;
+  int captures = 0;
+  float spikeMs = 0.f;
+
+  static constexpr int HistorySize = 128;
+  float history[HistorySize] = {};
+  int historyCount = 0;
+
+  // framesBefore + 1 + framesAfter frames, full when a capture is saved
+  std::vector<FrameSummary> summaries;
+  int summaryCount = 0;
+};
+
+static SpikeCapture spike;
+
+void spike_capture_init()
+{
+  spike.enabled = has_argument("--spike-capture");
+  if (!spike.enabled)
+    return;
+  spike.thresholdMs = get_argument("--spike-ms", spike.thresholdMs);
+  spike.medianFactor = get_argument("--spike-median-factor", spike.medianFactor);
+  spike.framesBefore = std::max(get_argument("--spike-frames-before", spike.framesBefore), 0);
+  spike.framesAfter = std::max(get_argument("--spike-frames", spike.framesAfter), 1);
+  spike.summaries.resize(spike.framesBefore + 1 + spike.framesAfter);
+  spike.maxCaptures = get_argument("--spike-max-captures", spike.maxCaptures);
+  spike.directory = get_argument("--spike-dir", "captures");
+  std::filesystem::create_directories(spike.directory);
+  debug_log("spike capture: > %.2f ms or > %.1fx median, %d frames before, %d after, into %s",
+            spike.thresholdMs, spike.medianFactor, spike.framesBefore, spike.framesAfter, spike.directory.c_str());
+}
+
+static float history_median()
+{
+  float sorted[SpikeCapture::HistorySize];
+  int n = std::min(spike.historyCount, SpikeCapture::HistorySize);
+  std::copy(spike.history, spike.history + n, sorted);
+  std::nth_element(sorted, sorted + n / 2, sorted + n);
+  return sorted[n / 2];
+}
+
+static bool is_spike(float ms)
+{
+  if (spike.frame < spike.warmup || spike.historyCount < SpikeCapture::HistorySize / 4)
+    return false;
+  if (spike.thresholdMs > 0.f && ms > spike.thresholdMs)
+    return true;
+  return spike.medianFactor > 0.f && ms > spike.medianFactor * history_median();
+}
+
+static void record_summary(float ms)
+{
+  FrameSummary &summary = spike.summaries[spike.summaryCount++ % spike.summaries.size()];
+  summary.frameMs = ms;
+  for (int p = 0; p < FramePhaseCount; p++)
+    summary.phaseMs[p] = get_phase_time(FramePhase(p));
+}
+
+// Frame and phase times around the spike, oldest first, the spike is at frame 0.
+static void save_summaries(const std::string &path)
+{
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file)
+  {
+    debug_error("can't write %s", path.c_str());
+    return;
+  }
+  fprintf(file, "frame,frame_ms");
+  for (int p = 0; p < FramePhaseCount; p++)
+    fprintf(file, ",%s", get_phase_name(FramePhase(p)));
+  fprintf(file, "\n");
+  const int size = spike.summaries.size();
+  const int count = std::min(spike.summaryCount, size);
+  for (int i = 0; i < count; i++)
+  {
+    const FrameSummary &summary = spike.summaries[(spike.summaryCount - count + i) % size];
+    fprintf(file, "%d,%.3f", i - (count - 1 - spike.framesAfter), summary.frameMs);
+    for (int p = 0; p < FramePhaseCount; p++)
+      fprintf(file, ",%.3f", summary.phaseMs[p]);
+    fprintf(file, "\n");
+  }
+  fclose(file);
+}
+
+static void on_spike(float ms)
+{
+  spike.state = SpikeState::AfterSpike;
+  spike.remaining = spike.framesAfter;
+  spike.spikeMs = ms;
+  debug_log("frame spike %.2f ms, capturing %d more frames", ms, spike.framesAfter);
+}
+
+void spike_capture_frame(float frame_time)
+{
+#if USE_OPTICK
+  if (!spike.enabled || spike.captures >= spike.maxCaptures)
+    return;
+  const float ms = frame_time * 1000.f;
+  const bool spiked = is_spike(ms);
+  spike.history[spike.historyCount++ % SpikeCapture::HistorySize] = ms;
+  spike.frame++;
+  record_summary(ms);
+
+  // Capture state changes are applied by Optick at the next OPTICK_FRAME, so nothing is forced here.
+  switch (spike.state)
+  {
+    case SpikeState::Idle:
+    {
+      // Instrumentation only, the sampling and context switch tracer is too heavy to restart every segment.
+      const bool started = Optick::StartCapture(Optick::Mode::INSTRUMENTATION, 1000, false);
+      if (spiked)
+        on_spike(ms);
+      else if (started)
+      {
+        spike.state = SpikeState::Recording;
+        spike.segmentFrames = 0;
+      }
+      break;
+    }
+
+    case SpikeState::Recording:
+      spike.segmentFrames++;
+      if (spiked)
+        on_spike(ms);
+      else if (spike.segmentFrames >= spike.framesBefore + spike.framesAfter)
+      {
+        // Optick has no ring buffer. Starting the next segment clears the thread event buffers, which keep
+        // their memory, and the frame list, so memory stays bounded. The .opt file thus holds anywhere from
+        // zero to framesBefore + framesAfter frames before the spike, the summary ring always holds framesBefore.
+        Optick::StopCapture(false);
+        spike.state = SpikeState::Idle;
+      }
+      break;
+
+    case SpikeState::AfterSpike:
+      if (--spike.remaining <= 0)
+      {
+        char name[64];
+        snprintf(name, sizeof(name), "spike_%d_%.0fms", spike.captures, spike.spikeMs);
+        const std::filesystem::path path = std::filesystem::path(spike.directory) / name;
+        const std::string optPath = path.string() + ".opt";
+        Optick::SaveCapture(optPath.c_str(), false);
+        save_summaries(path.string() + ".csv");
+        debug_log("spike capture saved to %s", optPath.c_str());
+        spike.captures++;
+        spike.state = SpikeState::Idle;
+      }
+      break;
+  }
+#else
+  (void)frame_time;
+#endif
+}
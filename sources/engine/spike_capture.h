@@ -0,0 +1,10 @@
+#pragma once
+
+// Spike triggered Optick capture, enabled with --spike-capture.
+// Optick records instrumentation events continuously in segments, when a frame exceeds --spike-ms or --spike-median-factor
+// times the rolling median, it keeps recording --spike-frames more frames and saves the capture
+// to --spike-dir as a .opt file without a client connected. Next to it a .csv holds the frame and phase times
+// of the last --spike-frames-before frames before the spike and of the frames after, whatever the segment held.
+void spike_capture_init();
+// frame_time in seconds.
+void spike_capture_frame(float frame_time);
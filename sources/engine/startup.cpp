@@ -0,0 +1,136 @@
+#include "startup.h"
+#include "command_line.h"
+#include "log.h"
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct StartupNode
+{
+  std::string name, asset;
+  int parent, depth;
+  double wallMs = 0, cpuMs = 0;
+  size_t bytes = 0; // own and children
+  std::chrono::steady_clock::time_point wallStart;
+  std::clock_t cpuStart;
+};
+
+static bool startupRecording = true;
+static std::vector<StartupNode> startupNodes;
+static int startupCurrent = -1;
+static auto startupBegin = std::chrono::steady_clock::now();
+
+StartupScope::StartupScope(const char *name, const char *asset)
+{
+  if (!startupRecording)
+    return;
+  node = startupNodes.size();
+  StartupNode &n = startupNodes.emplace_back();
+  n.name = name;
+  n.asset = asset ? asset : "";
+  n.parent = startupCurrent;
+  n.depth = startupCurrent >= 0 ? startupNodes[startupCurrent].depth + 1 : 0;
+  n.wallStart = std::chrono::steady_clock::now();
+  n.cpuStart = std::clock();
+  startupCurrent = node;
+}
+
+StartupScope::~StartupScope()
+{
+  if (node < 0 || !startupRecording)
+    return;
+  StartupNode &n = startupNodes[node];
+  n.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - n.wallStart).count();
+  n.cpuMs = double(std::clock() - n.cpuStart) * 1000.0 / CLOCKS_PER_SEC;
+  startupCurrent = n.parent;
+}
+
+void startup_add_bytes_read(size_t bytes)
+{
+  if (!startupRecording)
+    return;
+  for (int i = startupCurrent; i >= 0; i = startupNodes[i].parent)
+    startupNodes[i].bytes += bytes;
+}
+
+void startup_add_file_read(const char *path)
+{
+  if (!startupRecording)
+    return;
+  std::error_code ec;
+  uintmax_t size = std::filesystem::file_size(path, ec);
+  if (!ec)
+    startup_add_bytes_read(size);
+}
+
+static void write_json_string(FILE *file, const std::string &str)
+{
+  fputc('"', file);
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+      fputc('\\', file);
+    if ((unsigned char)c >= 0x20)
+      fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+static void write_json_node(FILE *file, int node)
+{
+  const StartupNode &n = startupNodes[node];
+  fprintf(file, "%*s{\"name\": ", n.depth * 2 + 2, "");
+  write_json_string(file, n.name);
+  if (!n.asset.empty())
+  {
+    fprintf(file, ", \"asset\": ");
+    write_json_string(file, n.asset);
+  }
+  fprintf(file, ", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"bytes_read\": %zu, \"children\": [", n.wallMs, n.cpuMs, n.bytes);
+  bool first = true;
+  for (int i = node + 1; i < (int)startupNodes.size(); i++)
+    if (startupNodes[i].parent == node)
+    {
+      fprintf(file, first ? "\n" : ",\n");
+      write_json_node(file, i);
+      first = false;
+    }
+  fprintf(file, "]}");
+}
+
+void startup_finish()
+{
+  if (!startupRecording)
+    return;
+  startupRecording = false;
+  double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+
+  debug_log("startup %.1f ms", totalMs);
+  debug_log("%10s %10s %12s", "wall ms", "cpu ms", "bytes read");
+  for (const StartupNode &n : startupNodes)
+    debug_log("%10.2f %10.2f %12zu %*s%s %s", n.wallMs, n.cpuMs, n.bytes, n.depth * 2, "", n.name.c_str(), n.asset.c_str());
+
+  const char *path = get_argument("--startup-json");
+  if (!path)
+    return;
+  FILE *file = fopen(path, "w");
+  if (!file)
+  {
+    debug_error("can't write startup report %s", path);
+    return;
+  }
+  fprintf(file, "{\"total_ms\": %.3f, \"phases\": [", totalMs);
+  bool first = true;
+  for (int i = 0; i < (int)startupNodes.size(); i++)
+    if (startupNodes[i].parent < 0)
+    {
+      fprintf(file, first ? "\n" : ",\n");
+      write_json_node(file, i);
+      first = false;
+    }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+}
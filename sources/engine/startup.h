@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+
+// Startup phase tree with wall time, CPU time and bytes read per scope.
+// Scopes are recorded on the main thread until startup_finish, after that they cost a branch.
+struct StartupScope
+{
+  int node = -1;
+  StartupScope(const char *name, const char *asset = nullptr);
+  ~StartupScope();
+};
+
+#define STARTUP_SCOPE_CONCAT_IMPL(a, b) a##b
+#define STARTUP_SCOPE_CONCAT(a, b) STARTUP_SCOPE_CONCAT_IMPL(a, b)
+#define STARTUP_SCOPE(...) StartupScope STARTUP_SCOPE_CONCAT(startup_scope_, __LINE__)(__VA_ARGS__)
+
+// Attributes bytes read from disk to the innermost open scope.
+void startup_add_bytes_read(size_t bytes);
+// Same for a whole file, by its size on disk.
+void startup_add_file_read(const char *path);
+
+// Ends recording, prints the phase tree and writes it to --startup-json <path> if passed.
+void startup_finish();
@@ -1,10 +1,15 @@
 #include <chrono>
+#include <log.h>
 
 
 using time_point = std::chrono::high_resolution_clock::time_point;
 
 static time_point startTime, curTime;
 static float savedTime, deltaTime; // in seconds
+static float fixedDeltaTime = 0.f; // deterministic frame step, 0 means real time
+static float simulationStep = 1.f / 60.f;
+static double simulationAccumulator = 0.0;
+const int MaxSimulationSteps = 8; // per frame, time above it is dropped
 
 void start_time()
 {
@@ -15,6 +20,13 @@ void start_time()
 void update_time()
 {
   time_point newTime = std::chrono::high_resolution_clock::now();
+  if (fixedDeltaTime > 0.f)
+  {
+    curTime = newTime;
+    deltaTime = fixedDeltaTime;
+    savedTime += fixedDeltaTime;
+    return;
+  }
   std::chrono::duration<float> d = newTime - curTime;
   deltaTime = d.count();
   curTime = newTime;
@@ -22,6 +34,45 @@ void update_time()
   savedTime = d.count();
 }
 
+void set_fixed_delta_time(float dt)
+{
+  fixedDeltaTime = dt;
+}
+
+void set_simulation_rate(float hz)
+{
+  // zero or negative rates would freeze the simulation or run it backwards
+  if (!(hz > 0.f))
+  {
+    debug_error("simulation rate %f Hz is not positive, keeping %f Hz", hz, 1.f / simulationStep);
+    return;
+  }
+  simulationStep = 1.f / hz;
+}
+
+float get_simulation_step()
+{
+  return simulationStep;
+}
+
+int update_simulation_time()
+{
+  simulationAccumulator += deltaTime;
+  int steps = int(simulationAccumulator / simulationStep);
+  if (steps > MaxSimulationSteps)
+  {
+    steps = MaxSimulationSteps;
+    simulationAccumulator = steps * (double)simulationStep;
+  }
+  simulationAccumulator -= steps * (double)simulationStep;
+  return steps;
+}
+
+float get_simulation_alpha()
+{
+  return float(simulationAccumulator / simulationStep);
+}
+
 float get_time()
 {
   return savedTime;
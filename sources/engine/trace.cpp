@@ -0,0 +1,138 @@
+#include "trace.h"
+#include "command_line.h"
+#include "log.h"
+#include "profiler.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+bool traceEnabled = false;
+
+struct TraceEvent
+{
+  const char *name;
+  int64_t start, duration;
+};
+
+// Events are appended to fixed size chunks, so recording never moves what was written before.
+constexpr size_t TraceChunkSize = 4096;
+using TraceChunk = std::vector<TraceEvent>;
+
+struct ThreadTrace
+{
+  int tid;
+  const char *name = nullptr;
+  std::vector<std::unique_ptr<TraceChunk>> chunks;
+};
+
+static std::mutex traceMutex;
+static std::vector<std::unique_ptr<ThreadTrace>> threadTraces;
+static std::string tracePath;
+static std::atomic<int64_t> eventBudget{0};
+static int64_t traceStart = 0;
+
+static ThreadTrace &get_thread_trace()
+{
+  static thread_local ThreadTrace *trace = nullptr;
+  if (!trace)
+  {
+    const FramePhase phase = set_current_phase(FramePhase::Count);
+    std::lock_guard<std::mutex> lock(traceMutex);
+    threadTraces.push_back(std::make_unique<ThreadTrace>());
+    trace = threadTraces.back().get();
+    trace->tid = threadTraces.size();
+    set_current_phase(phase);
+  }
+  return *trace;
+}
+
+void trace_init()
+{
+  const char *path = get_argument("--trace");
+  if (!path)
+    return;
+  tracePath = path;
+  eventBudget = get_argument("--trace-max-events", 4 << 20);
+  traceStart = trace_now();
+  traceEnabled = true;
+  trace_thread_name("MainThread");
+}
+
+void trace_thread_name(const char *name)
+{
+  if (traceEnabled)
+    get_thread_trace().name = name;
+}
+
+void trace_add_event(const char *name, int64_t start_ns, int64_t duration_ns)
+{
+  if (eventBudget.fetch_sub(1, std::memory_order_relaxed) <= 0)
+    return;
+  ThreadTrace &trace = get_thread_trace();
+  if (trace.chunks.empty() || trace.chunks.back()->size() == TraceChunkSize)
+  {
+    // counted outside of any phase, tracing must not trip the allocation budgets of the phase it records
+    const FramePhase phase = set_current_phase(FramePhase::Count);
+    trace.chunks.push_back(std::make_unique<TraceChunk>());
+    trace.chunks.back()->reserve(TraceChunkSize);
+    set_current_phase(phase);
+  }
+  trace.chunks.back()->push_back({name, start_ns, duration_ns});
+}
+
+static void write_json_string(FILE *file, const char *str)
+{
+  fputc('"', file);
+  for (; *str; str++)
+  {
+    if (*str == '"' || *str == '\\')
+      fputc('\\', file);
+    if ((unsigned char)*str >= 0x20)
+      fputc(*str, file);
+  }
+  fputc('"', file);
+}
+
+void trace_write()
+{
+  if (!traceEnabled)
+    return;
+  traceEnabled = false;
+  FILE *file = fopen(tracePath.c_str(), "w");
+  if (!file)
+  {
+    debug_error("can't write trace %s", tracePath.c_str());
+    return;
+  }
+  std::lock_guard<std::mutex> lock(traceMutex);
+  size_t count = 0;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  const char *separator = "";
+  for (const auto &trace : threadTraces)
+  {
+    if (trace->name)
+    {
+      fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", separator, trace->tid);
+      write_json_string(file, trace->name);
+      fprintf(file, "}}");
+      separator = ",\n";
+    }
+    for (const auto &chunk : trace->chunks)
+      for (const TraceEvent &event : *chunk)
+      {
+        // trace-event timestamps are microseconds
+        fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":", separator, trace->tid,
+                (event.start - traceStart) * 1e-3, event.duration * 1e-3);
+        write_json_string(file, event.name);
+        fputc('}', file);
+        separator = ",\n";
+        count++;
+      }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  debug_log("trace with %zu events written to %s", count, tracePath.c_str());
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optick.h>
+
+// In-process recorder of instrumented scopes, written as Chrome trace-event json
+// (chrome://tracing, ui.perfetto.dev) when the app was started with --trace <path>.
+void trace_init();
+// Writes the recorded events, called on exit.
+void trace_write();
+// Names the calling thread in the trace, name must outlive the recorder.
+void trace_thread_name(const char *name);
+
+extern bool traceEnabled;
+
+// name must be a string literal or otherwise outlive the recorder
+void trace_add_event(const char *name, int64_t start_ns, int64_t duration_ns);
+
+inline int64_t trace_now()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct TraceScope
+{
+  const char *name;
+  int64_t start;
+
+  TraceScope(const char *name) : name(name), start(traceEnabled ? trace_now() : 0) {}
+  ~TraceScope()
+  {
+    if (traceEnabled)
+      trace_add_event(name, start, trace_now() - start);
+  }
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+// Optick event which is also recorded by the trace recorder.
+#define PROFILE_EVENT(name) OPTICK_EVENT(name); TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define PROFILE_GPU_EVENT(name) OPTICK_GPU_EVENT(name); TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
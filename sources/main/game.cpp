@@ -6,98 +6,28 @@
 #include "camera.h"
 #include <application.h>
 #include <render/debug_arrow.h>
+#include <render/culling.h>
+#include <render/occlusion.h>
 #include <imgui/imgui.h>
 #include "ImGuizmo.h"
+#include <animation/character.h>
+#include <animation/motion_matching.h>
 
 #include "ozz/animation/runtime/animation.h"
-#include "ozz/animation/runtime/local_to_model_job.h"
-#include "ozz/animation/runtime/sampling_job.h"
 #include "ozz/animation/runtime/skeleton.h"
-#include "ozz/animation/runtime/blending_job.h"
 #include "ozz/base/maths/simd_math.h"
-#include "ozz/base/maths/soa_transform.h"
 
 #include <optick.h>
-
-struct PlaybackController
-{
-public:
-  // Updates animation time if in "play" state, according to playback speed and
-  // given frame time _dt.
-  // Returns true if animation has looped during update
-  void Update(const AnimationPtr &_animation, float _dt)
-  {
-    float new_time = time_ratio_;
-
-    if (play_)
-    {
-      new_time = time_ratio_ + _dt * playback_speed_ / _animation->duration();
-    }
-    if (loop_)
-    {
-      // Wraps in the unit interval [0:1], even for negative values (the reason
-      // for using floorf).
-      time_ratio_ = new_time - floorf(new_time);
-    }
-    else
-    {
-      // Clamps in the unit interval [0:1].
-      time_ratio_ = new_time;
-    }
-  }
-
-  void Reset()
-  {
-    time_ratio_ = 0.f;
-    playback_speed_ = 1.f;
-    play_ = true;
-    loop_ = true;
-  }
-
-  // Current animation time ratio, in the unit interval [0,1], where 0 is the
-  // beginning of the animation, 1 is the end.
-  float time_ratio_;
-
-  // Playback speed, can be negative in order to play the animation backward.
-  float playback_speed_;
-
-  // Animation play mode state: play/pause.
-  bool play_;
-
-  // Animation loop mode.
-  bool loop_;
-};
-
-struct AnimationLayer
-{
-  // Constructor, default initialization.
-  AnimationLayer(const SkeletonPtr &skeleton, AnimationPtr animation) : weight(1.f), animation(animation)
-  {
-    controller.Reset();
-
-    locals.resize(skeleton->skeleton->num_soa_joints());
-
-    // Allocates a context that matches animation requirements.
-    context = std::make_shared<ozz::animation::SamplingJob::Context>(skeleton->skeleton->num_joints());
-  }
-
-  bool isAdditive = false;
-  // Playback animation controller. This is a utility class that helps with
-  // controlling animation playback time.
-  PlaybackController controller;
-
-  // Blending weight for the layer.
-  float weight;
-
-  // Runtime animation.
-  AnimationPtr animation;
-
-  // Sampling context.
-  std::shared_ptr<ozz::animation::SamplingJob::Context> context;
-
-  // Buffer of local transforms as sampled from animation_.
-  std::vector<ozz::math::SoaTransform> locals;
-};
+#include <profiler.h>
+#include <trace.h>
+#include <startup.h>
+#include <perf_counters.h>
+#include <probes.h>
+#include <command_line.h>
+#include <counters.h>
+#include <parallel.h>
+#include <algorithm>
+#include <cfloat>
 
 struct UserCamera
 {
@@ -106,32 +36,6 @@ struct UserCamera
   ArcballCamera arcballCamera;
 };
 
-struct Character
-{
-  glm::mat4 transform;
-  std::vector<MeshPtr> meshes;
-  MaterialPtr material;
-  GPUBuffer skeletonBuffer;
-
-  // Runtime skeleton.
-  SkeletonPtr skeleton_;
-
-  // Sampling context.
-  std::shared_ptr<ozz::animation::SamplingJob::Context> context_;
-
-  // Buffer of local transforms as sampled from animation_.
-  std::vector<ozz::math::SoaTransform> locals_;
-
-  // Buffer of model space matrices.
-  std::vector<ozz::math::Float4x4> models_;
-
-  std::vector<AnimationLayer> layers;
-
-  AnimationPtr currentAnimation;
-  PlaybackController controller;
-
-};
-
 struct Scene
 {
   DirectionLight light;
@@ -139,14 +43,37 @@ struct Scene
   UserCamera userCamera;
 
   std::vector<Character> characters;
+
+  OcclusionBuffer occlusion;
+
+  // culling scratch, kept between frames so culling does not allocate
+  std::vector<vec4> cullBounds;
+  std::vector<uint8_t> cullVisible;
+  std::vector<int> occluderOrder;
 };
 
 static std::unique_ptr<Scene> scene;
+static bool frustumCulling = true;
+static bool occlusionCulling = true;
+static int maxOccluders = 16;
+static bool meshLods = true;
+static bool skeletonLods = true;
+static float lodBias = 1.f;
+// projected bounds radius in NDC units below which lod 1 is used, every next level halves it
+static const float LodScreenSize = 0.5f;
+
+// occlusion buffer resolution, coarse enough to clear and rasterize in a few microseconds
+static const int OcclusionWidth = 256;
+static const int OcclusionHeight = 128;
+// Characters occlude with the bone space skin boxes of their torso joints, shrunk around the center and posed with
+// the bone. A box of half the extent of the bounds of an elliptic section stays inside it, 0.5^2 + 0.5^2 < 1.
+static const float OccluderShrink = 0.5f;
 static std::vector<std::string> animationList;
 
 #include <filesystem>
 static std::vector<std::string> scan_animations(const char *path)
 {
+  STARTUP_SCOPE("scan_animations", path);
   std::vector<std::string> animations;
   for (auto &p : std::filesystem::recursive_directory_iterator(path))
   {
@@ -157,6 +84,24 @@ static std::vector<std::string> scan_animations(const char *path)
   return animations;
 }
 
+// Offline step, every clip of the library goes into one database which the runtime loads.
+static void build_motion_database_file(const SkeletonPtr &skeleton, const char *path)
+{
+  STARTUP_SCOPE("build_motion_database", path);
+  MotionJoints joints;
+  if (!find_motion_joints(*skeleton, joints))
+    return;
+  std::vector<AnimationPtr> clips;
+  for (const std::string &animationPath : animationList)
+  {
+    SceneAsset asset = load_scene(animationPath.c_str(), SceneAsset::LoadScene::Skeleton | SceneAsset::LoadScene::Animation, skeleton);
+    clips.insert(clips.end(), asset.animations.begin(), asset.animations.end());
+  }
+  MotionDatabase database = build_motion_database(*skeleton, joints, clips);
+  if (database.frameCount > 0 && save_motion_database(database, path))
+    debug_log("motion database with %d frames saved to %s", database.frameCount, path);
+}
+
 Character create_character(glm::vec3 position, std::vector<MeshPtr> meshes, MaterialPtr material, SkeletonPtr skeleton, AnimationPtr animation)
 {
   Character character;
@@ -181,11 +126,26 @@ Character create_character(glm::vec3 position, std::vector<MeshPtr> meshes, Mate
 
   character.skeletonBuffer = GPUBuffer(BufferType::Storage, 0, sizeof(ozz::math::Float4x4) * num_joints);
 
+  // initial pose, so there is something to render before the first simulation step
+  update_character(character, 0.f);
+  character.prevModels_ = character.models_;
+  character.renderModels_ = character.models_;
+  init_character_bounds(character);
+  update_character_bounds(character);
+  init_skeleton_lods(character, MeshLodCount);
+
   return character;
 }
 
 void game_init()
 {
+  set_simulation_rate(get_argument("--sim-hz", 60.f));
+  frustumCulling = !has_argument("--no-frustum-culling");
+  occlusionCulling = !has_argument("--no-occlusion-culling");
+  maxOccluders = get_argument("--occluders", maxOccluders);
+  meshLods = !has_argument("--no-mesh-lods");
+  skeletonLods = !has_argument("--no-skeleton-lods");
+  lodBias = get_argument("--lod-bias", lodBias);
   animationList = scan_animations("resources/Animations");
   scene = std::make_unique<Scene>();
   scene->light.lightDirection = glm::normalize(glm::vec3(-1, -1, 0));
@@ -214,11 +174,13 @@ void game_init()
   input.onMouseWheelEvent += [](const SDL_MouseWheelEvent &e)
   { arccam_mouse_wheel_handler(e, scene->userCamera.arcballCamera); };
 
+  // drops helper and end site joints which nothing is skinned to
+  const int pruneSkeleton = has_argument("--no-skeleton-pruning") ? 0 : SceneAsset::LoadScene::PruneSkeleton;
   {
     auto material = make_material("character", "sources/shaders/character_vs.glsl", "sources/shaders/character_ps.glsl");
     material->set_property("mainTex", create_texture2d("resources/sketchfab/color.png"));
     SceneAsset sceneAsset = load_scene("resources/sketchfab/ruby.fbx",
-                                      SceneAsset::LoadScene::Meshes | SceneAsset::LoadScene::Skeleton | SceneAsset::LoadScene::Animation);
+                                      SceneAsset::LoadScene::Meshes | SceneAsset::LoadScene::Skeleton | SceneAsset::LoadScene::Animation | pruneSkeleton);
 
     scene->characters.emplace_back(create_character(
         glm::vec3(1, 0, 0),
@@ -232,7 +194,7 @@ void game_init()
   material->set_property("mainTex", create_texture2d("resources/MotusMan_v55/MCG_diff.jpg"));
 
   SceneAsset sceneAsset = load_scene("resources/MotusMan_v55/MotusMan_v55.fbx",
-                                     SceneAsset::LoadScene::Meshes | SceneAsset::LoadScene::Skeleton);
+                                     SceneAsset::LoadScene::Meshes | SceneAsset::LoadScene::Skeleton | pruneSkeleton);
 
   SceneAsset runAnimationAsset = load_scene("resources/Animations/IPC/MOB1_Run_F_Loop_IPC.fbx",
                                             SceneAsset::LoadScene::Skeleton | SceneAsset::LoadScene::Animation, sceneAsset.skeleton);
@@ -247,6 +209,9 @@ void game_init()
       material,
       sceneAsset.skeleton, runAnimation));
 
+  if (has_argument("--build-motion-database"))
+    build_motion_database_file(sceneAsset.skeleton, get_argument("--motion-database", "motion_database.bin"));
+
   const bool stressTest = false;
   if (stressTest)
   {
@@ -268,87 +233,6 @@ void game_init()
   std::fflush(stdout);
 }
 
-void update_character(Character &character, float dt)
-{
-
-  if (!character.layers.empty())
-  {
-    for (AnimationLayer &layer : character.layers)
-    {
-      layer.controller.Update(layer.animation, dt);
-
-      // Samples optimized animation at t = animation_time_.
-      ozz::animation::SamplingJob sampling_job;
-      sampling_job.animation = layer.animation.get();
-      sampling_job.context = layer.context.get();
-      sampling_job.ratio = layer.controller.time_ratio_;
-      sampling_job.output = ozz::make_span(layer.locals);
-      if (!sampling_job.Run())
-      {
-        debug_error("sampling_job failed");
-      }
-    }
-
-    // Prepares blending layers.
-    int numLayer = character.layers.size();
-    std::vector<ozz::animation::BlendingJob::Layer> layers, additive;
-
-    for (int i = 0; i < numLayer; ++i)
-    {
-      ozz::animation::BlendingJob::Layer layer;
-      layer.transform = ozz::make_span(character.layers[i].locals);
-      layer.weight = character.layers[i].weight;
-      if (!character.layers[i].isAdditive)
-        layers.push_back(layer);
-      else
-        additive.push_back(layer);
-    }
-
-    // Setups blending job.
-    ozz::animation::BlendingJob blend_job;
-    blend_job.threshold = 0.1;
-    blend_job.layers = ozz::make_span(layers);
-    blend_job.additive_layers = ozz::make_span(additive);
-    blend_job.rest_pose = character.skeleton_->skeleton->joint_rest_poses();
-    blend_job.output = ozz::make_span(character.locals_);
-
-    // Blends.
-    if (!blend_job.Run())
-    {
-      debug_error("blend_job failed");
-      return;
-    }
-  }
-  else if (character.currentAnimation)
-  {
-    character.controller.Update(character.currentAnimation, dt);
-
-    // Samples optimized animation at t = animation_time_.
-    ozz::animation::SamplingJob sampling_job;
-    sampling_job.animation = character.currentAnimation.get();
-    sampling_job.context = character.context_.get();
-    sampling_job.ratio = character.controller.time_ratio_;
-    sampling_job.output = ozz::make_span(character.locals_);
-    if (!sampling_job.Run())
-    {
-      return;
-    }
-  }
-  else
-  {
-    auto restPose = character.skeleton_->skeleton->joint_rest_poses();
-    std::copy(restPose.begin(), restPose.end(), character.locals_.begin());
-  }
-  ozz::animation::LocalToModelJob ltm_job;
-  ltm_job.skeleton = character.skeleton_->skeleton.get();
-  ltm_job.input = ozz::make_span(character.locals_);
-  ltm_job.output = ozz::make_span(character.models_);
-  if (!ltm_job.Run())
-  {
-    return;
-  }
-}
-
 void game_update()
 {
   float dt = get_delta_time();
@@ -357,11 +241,29 @@ void game_update()
       scene->userCamera.transform,
       dt);
 
+  const int steps = update_simulation_time();
+  const float step = get_simulation_step();
+  for (int i = 0; i < steps; i++)
+    for (Character &character : scene->characters)
+    {
+      // culled last frame, game_render resamples the pose in the frame it becomes visible again
+      if (!character.visible)
+      {
+        advance_character_time(character, step);
+        continue;
+      }
+      PROFILE_EVENT("update_character");
+      PROFILE_PHASE(FramePhase::UpdateCharacter);
+      PerfScope perfScope(PerfPhase::Update, 1, character.skeleton_->skeleton->num_joints());
+
+      simulate_character(character, step);
+    }
+
+  const float alpha = get_simulation_alpha();
   for (Character &character : scene->characters)
   {
-    OPTICK_EVENT("update_character");
-
-    update_character(character, dt);
+    interpolate_character(character, alpha);
+    update_character_bounds(character);
   }
 }
 
@@ -372,7 +274,7 @@ static glm::mat4 to_glm(const ozz::math::Float4x4 &tm)
   return result;
 }
 
-void render_character(const Character &character, const mat4 &cameraProjView, vec3 cameraPosition, const DirectionLight &light, bool render_bones)
+void render_character(Character &character, const mat4 &cameraProjView, vec3 cameraPosition, const DirectionLight &light, bool render_bones)
 {
   const Material &material = *character.material;
   const Shader &shader = material.get_shader();
@@ -388,8 +290,6 @@ void render_character(const Character &character, const mat4 &cameraProjView, ve
 
   const auto &skeleton = *character.skeleton_->skeleton;
   size_t boneNumber = character.skeleton_->bindPose.size();
-  std::vector<ozz::math::Float4x4> bones(boneNumber/* , ozz::math::Float4x4::identity() */);
-
 
   size_t nodeCount = skeleton.num_joints();
   assert(boneNumber == nodeCount);
@@ -397,25 +297,24 @@ void render_character(const Character &character, const mat4 &cameraProjView, ve
   character.skeletonBuffer.bind();
 
   {
-    OPTICK_EVENT("render");
+    PROFILE_EVENT("render");
     for (const MeshPtr &mesh : character.meshes)
     {
       {
-        OPTICK_EVENT("matrix gather");
-        for (size_t i = 0; i < nodeCount; i++)
-        {
-          bones[i] = character.models_[i] * mesh->invBindPose[i];
-        }
+        PROFILE_EVENT("matrix gather");
+        // one palette per mesh, the character is counted once
+        PerfScope perfScope(PerfPhase::Palette, &mesh == &character.meshes.front(), nodeCount);
+        build_palette(character.renderModels_, mesh->invBindPose, character.palette);
       }
-      character.skeletonBuffer.update_buffer(bones.data(), sizeof(ozz::math::Float4x4) * boneNumber);
-      render(mesh);
+      character.skeletonBuffer.update_buffer(character.palette.data(), sizeof(ozz::math::Float4x4) * boneNumber);
+      render_lod(mesh, character.lod);
     }
   }
 
   if (!render_bones)
     return;
 
-  OPTICK_EVENT("bone_render");
+  PROFILE_EVENT("bone_render");
   for (size_t i = 0; i < nodeCount; i++)
   {
     for (size_t j = i; j < nodeCount; j++)
@@ -423,11 +322,11 @@ void render_character(const Character &character, const mat4 &cameraProjView, ve
       if (skeleton.joint_parents()[j] == int(i))
       {
         alignas(16) glm::vec3 offset;
-        ozz::math::Store3Ptr(character.models_[i].cols[3] - character.models_[j].cols[3], glm::value_ptr(offset));
+        ozz::math::Store3Ptr(character.renderModels_[i].cols[3] - character.renderModels_[j].cols[3], glm::value_ptr(offset));
 
-        glm::mat4 globTm = to_glm(character.models_[j]);
+        glm::mat4 globTm = to_glm(character.renderModels_[j]);
         offset = inverse(globTm) * glm::vec4(offset, .0f);
-        draw_arrow(character.transform * to_glm(character.models_[j]), vec3(0), offset, vec3(0, 0.5f, 0), 0.01f);
+        draw_arrow(character.transform * to_glm(character.renderModels_[j]), vec3(0), offset, vec3(0, 0.5f, 0), 0.01f);
       }
     }
   }
@@ -564,6 +463,17 @@ void imgui_render()
         ImGui::DragFloat("weight", &layer.weight, 0.01f, 0.f, 1.f);
         ImGui::Text("%s", layer.isAdditive ? "is additive" : "not additive");
 
+        std::vector<const char *> maskRoots(nodeCount + 1);
+        maskRoots[0] = "whole body";
+        for (size_t j = 0; j < nodeCount; j++)
+          maskRoots[j + 1] = skeleton.joint_names()[j];
+        int maskItem = layer.maskRoot + 1;
+        bool include = layer.maskInclude;
+        bool maskChanged = ImGui::Combo("mask root", &maskItem, maskRoots.data(), maskRoots.size());
+        maskChanged |= ImGui::Checkbox("include subtree", &include);
+        if (maskChanged)
+          set_layer_mask(layer, *character.skeleton_, maskItem - 1, include);
+
         if (ImGui::TreeNode("controller"))
         {
           playback_controller_inspector(layer.controller);
@@ -595,6 +505,59 @@ void imgui_render()
   }
 }
 
+static int select_lod(const Character &character, const mat4 &projection, vec3 camera_position)
+{
+  const float distance = std::max(glm::length(glm::vec3(character.bounds) - camera_position), 1e-3f);
+  const float screenSize = character.bounds.w * projection[1][1] / distance * lodBias;
+  int lod = 0;
+  for (float threshold = LodScreenSize; screenSize < threshold && lod < MeshLodCount - 1; threshold *= 0.5f)
+    lod++;
+  return lod;
+}
+
+// The nearest visible characters are rasterized as occluders, then all visible ones are tested against them.
+static void occlusion_cull(const mat4 &proj_view, vec3 camera_position, std::vector<uint8_t> &visible)
+{
+  PROFILE_EVENT("occlusion_culling");
+  OcclusionBuffer &occlusion = scene->occlusion;
+  occlusion_begin(occlusion, OcclusionWidth, OcclusionHeight, proj_view);
+
+  // characters without skinned bounds are never culled, neither do they occlude
+  std::vector<int> &order = scene->occluderOrder;
+  order.clear();
+  for (size_t i = 0; i < visible.size(); i++)
+    if (visible[i] && scene->characters[i].bounds.w != FLT_MAX)
+      order.push_back(i);
+  auto distance = [&](int i) { return glm::length2(glm::vec3(scene->characters[i].bounds) - camera_position); };
+  const int occluders = std::min<int>(maxOccluders, order.size());
+  std::partial_sort(order.begin(), order.begin() + occluders, order.end(), [&](int a, int b) { return distance(a) < distance(b); });
+  for (int i = 0; i < occluders; i++)
+  {
+    const Character &character = scene->characters[order[i]];
+    for (int joint : character.occluderJoints)
+    {
+      const BoneBounds &bone = character.jointBounds[joint];
+      const vec3 center = (bone.boxMin + bone.boxMax) * 0.5f;
+      const vec3 extent = (bone.boxMax - bone.boxMin) * 0.5f * OccluderShrink;
+      occlusion_add_oriented_box(occlusion, character.transform * to_glm(character.renderModels_[joint]), center - extent, center + extent);
+    }
+  }
+  occlusion_rasterize(occlusion);
+
+  parallel_for(order.size(), 16, [&](int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      const Character &character = scene->characters[order[i]];
+      if (!occlusion_test_box(occlusion, character.boundsMin, character.boundsMax))
+      {
+        visible[order[i]] = 0;
+        add_counter(FrameCounter::CharactersOccluded);
+      }
+    }
+  });
+}
+
 void game_render()
 {
   glEnable(GL_DEPTH_TEST);
@@ -607,14 +570,56 @@ void game_render()
   const glm::mat4 &transform = scene->userCamera.transform;
   glm::mat4 projView = projection * inverse(transform);
 
+  {
+    PROFILE_EVENT("frustum_culling");
+    const size_t count = scene->characters.size();
+    std::vector<vec4> &bounds = scene->cullBounds;
+    std::vector<uint8_t> &visible = scene->cullVisible;
+    bounds.resize(count);
+    visible.assign(count, 1);
+    for (size_t i = 0; i < count; i++)
+      bounds[i] = scene->characters[i].bounds;
+    if (frustumCulling)
+      cull_spheres(make_frustum(projView), bounds.data(), count, visible.data());
+    add_counter(FrameCounter::CharactersCulled, std::count(visible.begin(), visible.end(), 0));
+
+    if (occlusionCulling && count > 1)
+      occlusion_cull(projView, glm::vec3(transform[3]), visible);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      Character &character = scene->characters[i];
+      character.visible = visible[i];
+      if (character.visible)
+      {
+        // culled until now, game_update only advanced its time
+        if (character.poseStale)
+        {
+          PROFILE_PHASE(FramePhase::UpdateCharacter);
+          refresh_stale_pose(character, get_simulation_alpha());
+        }
+        const int lod = select_lod(character, projection, glm::vec3(transform[3]));
+        character.lod = meshLods ? lod : 0;
+        character.skeletonLod = skeletonLods ? lod : 0;
+      }
+    }
+  }
+
   for (size_t i = 0; i < scene->characters.size(); i++)
   {
-    OPTICK_EVENT("render_character");
+    if (!scene->characters[i].visible)
+      continue;
+    PROFILE_GPU_EVENT("render_character");
+    PROFILE_PHASE(FramePhase::RenderCharacter);
+    const int numJoints = scene->characters[i].skeleton_->skeleton->num_joints();
+    PerfScope perfScope(PerfPhase::Render, 1, numJoints);
+    PROBE2(render_character_entry, numJoints, scene->characters[i].meshes.size());
     render_character(scene->characters[i], projView, glm::vec3(transform[3]), scene->light, i < 10);
+    PROBE1(render_character_return, numJoints);
   }
 
   {
-    OPTICK_EVENT("render_arrows");
+    PROFILE_GPU_EVENT("render_arrows");
     render_arrows(projView, glm::vec3(transform[3]), scene->light);
   }
 }
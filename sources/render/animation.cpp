@@ -15,8 +15,13 @@
 #include <assimp/scene.h>
 #include "render/scene.h"
 #include "log.h"
+#include <memory_stats.h>
+#include <probes.h>
+#include <unordered_set>
 
-void build_skeleton(ozz::animation::offline::RawSkeleton::Joint &root, const aiNode &ai_root)
+// kept limits the hierarchy to the given nodes, all of it is converted without it
+static void build_skeleton(ozz::animation::offline::RawSkeleton::Joint &root, const aiNode &ai_root,
+                           const std::unordered_set<const aiNode *> *kept = nullptr)
 {
   root.name = ai_root.mName.C_Str();
   debug_log("joint %s", root.name.c_str());
@@ -29,10 +34,30 @@ void build_skeleton(ozz::animation::offline::RawSkeleton::Joint &root, const aiN
   root.transform.rotation = ozz::math::Quaternion(rotation.x, rotation.y, rotation.z, rotation.w);
   root.transform.scale = ozz::math::Float3(scaling.x, scaling.y, scaling.z);
 
-  root.children.resize(ai_root.mNumChildren);
-
+  root.children.reserve(ai_root.mNumChildren);
   for (size_t i = 0; i < ai_root.mNumChildren; i++)
-    build_skeleton(root.children[i], *ai_root.mChildren[i]);
+    if (!kept || kept->count(ai_root.mChildren[i]))
+      build_skeleton(root.children.emplace_back(), *ai_root.mChildren[i], kept);
+}
+
+// Keeps the nodes with a needed name and their ancestors, returns true if the subtree has one of them.
+static bool mark_needed_joints(const aiNode &node, const std::unordered_set<std::string> &needed,
+                               std::unordered_set<const aiNode *> &kept)
+{
+  bool result = needed.count(node.mName.C_Str()) > 0;
+  for (size_t i = 0; i < node.mNumChildren; i++)
+    result |= mark_needed_joints(*node.mChildren[i], needed, kept);
+  if (result)
+    kept.insert(&node);
+  return result;
+}
+
+static int count_nodes(const aiNode &node)
+{
+  int result = 1;
+  for (size_t i = 0; i < node.mNumChildren; i++)
+    result += count_nodes(*node.mChildren[i]);
+  return result;
 }
 
 SkeletonPtr create_skeleton(const aiNode &ai_root)
@@ -44,6 +69,40 @@ SkeletonPtr create_skeleton(const aiNode &ai_root)
   raw_skeleton.roots.resize(1);
   build_skeleton(raw_skeleton.roots[0], ai_root);
 
+  return create_skeleton(raw_skeleton);
+}
+
+SkeletonPtr create_skeleton(const aiScene &scene, const std::vector<std::string> &keep_joints)
+{
+  std::unordered_set<std::string> needed(keep_joints.begin(), keep_joints.end());
+  bool skinned = false;
+  for (size_t i = 0; i < scene.mNumMeshes; i++)
+    for (size_t j = 0; j < scene.mMeshes[i]->mNumBones; j++)
+    {
+      const aiBone *bone = scene.mMeshes[i]->mBones[j];
+      if (bone->mNumWeights > 0)
+      {
+        needed.insert(bone->mName.C_Str());
+        skinned = true;
+      }
+    }
+  // a clip only file has no skin to decide with
+  if (!skinned)
+    return create_skeleton(*scene.mRootNode);
+
+  std::unordered_set<const aiNode *> kept;
+  mark_needed_joints(*scene.mRootNode, needed, kept);
+  kept.insert(scene.mRootNode);
+
+  ozz::animation::offline::RawSkeleton raw_skeleton;
+  raw_skeleton.roots.resize(1);
+  build_skeleton(raw_skeleton.roots[0], *scene.mRootNode, &kept);
+  debug_log("skeleton pruned from %d to %d joints", count_nodes(*scene.mRootNode), int(kept.size()));
+  return create_skeleton(raw_skeleton);
+}
+
+SkeletonPtr create_skeleton(const ozz::animation::offline::RawSkeleton &raw_skeleton)
+{
   if (!raw_skeleton.Validate())
   {
     debug_error("skeleton validation failed");
@@ -84,7 +143,19 @@ SkeletonPtr create_skeleton(const aiNode &ai_root)
     result.bindPose[i] = worldTm[i];
   }
 
-  result.skeleton = std::move(skeleton);
+  size_t cpuBytes = numJoints * (sizeof(int16_t) + sizeof(char *) + 2 * sizeof(ozz::math::Float4x4)) +
+                    skeleton->num_soa_joints() * sizeof(ozz::math::SoaTransform);
+  for (const char *name : skeleton->joint_names())
+    cpuBytes += strlen(name) + 1;
+  const uintptr_t id = (uintptr_t)skeleton.get();
+  track_resource(ResourceType::Skeleton, id, numJoints > 0 ? skeleton->joint_names()[0] : "skeleton", cpuBytes, 0);
+
+  auto deleter = skeleton.get_deleter();
+  result.skeleton = std::shared_ptr<ozz::animation::Skeleton>(skeleton.release(), [deleter](ozz::animation::Skeleton *s) mutable
+  {
+    untrack_resource(ResourceType::Skeleton, (uintptr_t)s);
+    deleter(s);
+  });
   return std::make_shared<Skeleton>(std::move(result));
 }
 
@@ -174,14 +245,21 @@ AnimationPtr create_animation(const aiAnimation &ai_animation, const SkeletonPtr
     }
   }
 
+  return create_animation(raw_animation, skeleton_, build_as_additive);
+}
+
+AnimationPtr create_animation(const ozz::animation::offline::RawAnimation &raw_animation, const SkeletonPtr &skeleton_, bool build_as_additive)
+{
   // Test for animation validity. These are the errors that could invalidate
   // an animation:
   //  1. Animation duration is less than 0.
   //  2. Keyframes' are not sorted in a strict ascending order.
   //  3. Keyframes' are not within [0, duration] range.
+  PROBE2(create_animation_entry, raw_animation.num_tracks(), build_as_additive);
   if (!raw_animation.Validate())
   {
     debug_error("animation validation failed");
+    PROBE1(create_animation_return, 0);
     return nullptr;
   }
 
@@ -199,10 +277,19 @@ AnimationPtr create_animation(const aiAnimation &ai_animation, const SkeletonPtr
   ozz::unique_ptr<ozz::animation::Animation> animation;
   if (build_as_additive)
   {
+    const auto &skeleton = skeleton_->skeleton;
+    std::vector<ozz::math::Transform> restPose(skeleton->num_joints());
+    for (int jointIdx = 0; jointIdx < skeleton->num_joints(); jointIdx++)
+      restPose[jointIdx] = ozz::animation::GetJointLocalRestPose(*skeleton, jointIdx);
 
     ozz::animation::offline::AdditiveAnimationBuilder additiveBuilder;
     ozz::animation::offline::RawAnimation output;
-    assert(additiveBuilder(raw_animation, ozz::make_span(restPose), &output));
+    if (!additiveBuilder(raw_animation, ozz::make_span(restPose), &output))
+    {
+      debug_error("additive animation build failed");
+      PROBE1(create_animation_return, 0);
+      return nullptr;
+    }
     animation = builder(output);
   }
   else
@@ -216,5 +303,12 @@ AnimationPtr create_animation(const aiAnimation &ai_animation, const SkeletonPtr
   debug_log("animation %s raw size = %d, runtime size = %d", animation->name(), raw_animation.size(), animation->size());
 
   std::fflush(stdout);
-  return std::shared_ptr<ozz::animation::Animation>(std::move(animation));
+  PROBE1(create_animation_return, animation->size());
+  track_resource(ResourceType::Animation, (uintptr_t)animation.get(), animation->name(), animation->size(), 0);
+  auto deleter = animation.get_deleter();
+  return std::shared_ptr<ozz::animation::Animation>(animation.release(), [deleter](ozz::animation::Animation *a) mutable
+  {
+    untrack_resource(ResourceType::Animation, (uintptr_t)a);
+    deleter(a);
+  });
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "culling.h"
+#include <algorithm>
+#include "ozz/base/maths/simd_math.h"
+
+Frustum make_frustum(const mat4 &proj_view)
+{
+  const mat4 m = transpose(proj_view);
+  Frustum frustum;
+  frustum.planes[0] = m[3] + m[0];
+  frustum.planes[1] = m[3] - m[0];
+  frustum.planes[2] = m[3] + m[1];
+  frustum.planes[3] = m[3] - m[1];
+  frustum.planes[4] = m[3] + m[2];
+  frustum.planes[5] = m[3] - m[2];
+  for (vec4 &plane : frustum.planes)
+    plane /= length(vec3(plane));
+  return frustum;
+}
+
+void cull_spheres(const Frustum &frustum, const vec4 *spheres, int count, uint8_t *visible)
+{
+  using namespace ozz::math;
+  SimdFloat4 planes[6][4];
+  for (int p = 0; p < 6; p++)
+    for (int c = 0; c < 4; c++)
+      planes[p][c] = simd_float4::Load1(frustum.planes[p][c]);
+
+  const SimdFloat4 zero = simd_float4::zero();
+  for (int i = 0; i < count; i += 4)
+  {
+    // transposes the next four spheres, the tail is padded with copies of the last one
+    const vec4 &s0 = spheres[i];
+    const vec4 &s1 = spheres[std::min(i + 1, count - 1)];
+    const vec4 &s2 = spheres[std::min(i + 2, count - 1)];
+    const vec4 &s3 = spheres[std::min(i + 3, count - 1)];
+    const SimdFloat4 x = simd_float4::Load(s0.x, s1.x, s2.x, s3.x);
+    const SimdFloat4 y = simd_float4::Load(s0.y, s1.y, s2.y, s3.y);
+    const SimdFloat4 z = simd_float4::Load(s0.z, s1.z, s2.z, s3.z);
+    const SimdFloat4 r = simd_float4::Load(s0.w, s1.w, s2.w, s3.w);
+
+    int outside = 0;
+    for (int p = 0; p < 6; p++)
+    {
+      const SimdFloat4 distance = MAdd(planes[p][0], x, MAdd(planes[p][1], y, MAdd(planes[p][2], z, planes[p][3])));
+      outside |= MoveMask(CmpLt(distance + r, zero));
+    }
+    for (int j = 0; j < 4 && i + j < count; j++)
+      visible[i + j] = (outside >> j) & 1 ? 0 : 1;
+  }
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <3dmath.h>
+
+// Inward facing planes (xyz normal, w distance) of a GL clip space frustum.
+struct Frustum
+{
+  vec4 planes[6];
+};
+
+Frustum make_frustum(const mat4 &proj_view);
+
+// Tests bounding spheres (xyz center, w radius) four at a time, visible[i] is 1 when sphere i touches the frustum.
+void cull_spheres(const Frustum &frustum, const vec4 *spheres, int count, uint8_t *visible);
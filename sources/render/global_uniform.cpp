@@ -2,6 +2,11 @@
 #include "log.h"
 #include "global_uniform.h"
 #include "glad/glad.h"
+#include <counters.h>
+#include <memory_stats.h>
+#include <probes.h>
+#include <string>
+#include <utility>
 
 GPUBuffer::GPUBuffer(BufferType type, int bindID, uint initialSize) : bufType(type == BufferType::Storage ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER), bindID(bindID), bufSize(initialSize)
 {
@@ -9,6 +14,30 @@ GPUBuffer::GPUBuffer(BufferType type, int bindID, uint initialSize) : bufType(ty
   glBindBuffer(bufType, arrayID);
   glBufferData(bufType, initialSize, NULL, GL_DYNAMIC_DRAW);
   glBindBuffer(bufType, 0);
+  track_resource(ResourceType::GPUBuffer, arrayID, "buffer " + std::to_string(arrayID), 0, initialSize);
+}
+
+GPUBuffer::GPUBuffer(GPUBuffer &&other) noexcept :
+  arrayID(std::exchange(other.arrayID, 0)), bufType(other.bufType), bindID(other.bindID), bufSize(std::exchange(other.bufSize, 0))
+{
+}
+
+// the old buffer goes to other and is deleted with it
+GPUBuffer &GPUBuffer::operator=(GPUBuffer &&other) noexcept
+{
+  std::swap(arrayID, other.arrayID);
+  std::swap(bufType, other.bufType);
+  std::swap(bindID, other.bindID);
+  std::swap(bufSize, other.bufSize);
+  return *this;
+}
+
+GPUBuffer::~GPUBuffer()
+{
+  if (arrayID == 0)
+    return;
+  glDeleteBuffers(1, &arrayID);
+  untrack_resource(ResourceType::GPUBuffer, arrayID);
 }
 
 size_t GPUBuffer::size() const
@@ -22,21 +51,25 @@ void GPUBuffer::resize_buffer(size_t size)
   {
     glBufferData(bufType, size, NULL, GL_DYNAMIC_DRAW);
     bufSize = size;
+    track_resource(ResourceType::GPUBuffer, arrayID, "buffer " + std::to_string(arrayID), 0, size);
   }
 }
 void GPUBuffer::update_buffer(const void *data, size_t size) const
 {
+  PROBE2(update_buffer_entry, arrayID, size);
   glBindBuffer(bufType, arrayID);
   glBindBufferBase(bufType, bindID, arrayID);
   if (bufSize >= size)
   {
   glBufferSubData(bufType, 0, size, data);
+  add_counter(FrameCounter::BufferUploadBytes, size);
 
   }
   else
     debug_error("buffer size is less than data size % < %", bufSize, size);
 
   glBindBuffer(bufType, 0);
+  PROBE2(update_buffer_return, arrayID, size);
 }
 
 void GPUBuffer::bind() const
@@ -8,16 +8,22 @@ enum class BufferType
   Storage
 };
 
+// Owns the GL buffer, so it can be moved but not copied.
 struct GPUBuffer
 {
 private:
-  uint arrayID;
-  uint bufType;
-  int bindID;
-  uint bufSize;
+  uint arrayID = 0;
+  uint bufType = 0;
+  int bindID = 0;
+  uint bufSize = 0;
 public:
   GPUBuffer() = default;
   GPUBuffer(BufferType type, int bindID, uint initialSize);
+  GPUBuffer(const GPUBuffer &) = delete;
+  GPUBuffer &operator=(const GPUBuffer &) = delete;
+  GPUBuffer(GPUBuffer &&other) noexcept;
+  GPUBuffer &operator=(GPUBuffer &&other) noexcept;
+  ~GPUBuffer();
 
   size_t size() const;
   void resize_buffer(size_t size);
@@ -1,4 +1,5 @@
 #include "material.h"
+#include <counters.h>
 
 
 void Material::bind_uniforms_to_shader() const
@@ -23,6 +24,7 @@ void Material::bind_uniforms_to_shader() const
       unsigned textureObject = (*v)->textureObject;
       glActiveTexture(GL_TEXTURE0 + textureBinding);
       glBindTexture(GL_TEXTURE_2D, textureObject);
+      add_counter(FrameCounter::TextureBinds);
       glUniform1i(location, textureBinding);
       textureBinding++;
     }
@@ -1,28 +1,38 @@
 #include "mesh.h"
 #include <vector>
+#include <algorithm>
 #include <3dmath.h>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <log.h>
+#include <counters.h>
+#include <memory_stats.h>
+#include <probes.h>
+#include <startup.h>
 #include "glad/glad.h"
 #include "scene.h"
+#include "simplify.h"
+#include "mesh_optimize.h"
+#include "vertex_format.h"
 
 #include "ozz/animation/runtime/skeleton.h"
 #include "ozz/animation/runtime/skeleton_utils.h"
 #include "ozz/animation/runtime/local_to_model_job.h"
 #include "ozz/base/maths/simd_math.h"
 
-static void create_indices(const std::vector<unsigned int> &indices)
+template <typename Index>
+static GLuint create_indices(const std::vector<Index> &indices)
 {
   GLuint arrayIndexBuffer;
   glGenBuffers(1, &arrayIndexBuffer);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arrayIndexBuffer);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
   glBindVertexArray(0);
+  return arrayIndexBuffer;
 }
 
-static void init_channel(int index, size_t data_size, const void *data_ptr, int component_count, bool is_float)
+static GLuint init_channel(int index, size_t data_size, const void *data_ptr, int component_count, bool is_float)
 {
   GLuint arrayBuffer;
   glGenBuffers(1, &arrayBuffer);
@@ -34,42 +44,101 @@ static void init_channel(int index, size_t data_size, const void *data_ptr, int
     glVertexAttribPointer(index, component_count, GL_FLOAT, GL_FALSE, 0, 0);
   else
     glVertexAttribIPointer(index, component_count, GL_UNSIGNED_INT, 0, 0);
+  return arrayBuffer;
 }
 
 template <int i>
-static void InitChannel() {}
+static void InitChannel(std::vector<uint32_t> &) {}
 
 template <int i, typename T, typename... Channel>
-static void InitChannel(const std::vector<T> &channel, const Channel &...channels)
+static void InitChannel(std::vector<uint32_t> &buffers, const std::vector<T> &channel, const Channel &...channels)
 {
   if (channel.size() > 0)
   {
     const int size = sizeof(T) / sizeof(channel[0][0]);
-    init_channel(i, sizeof(T) * channel.size(), channel.data(), size, !(std::is_same<T, uvec4>::value));
+    buffers.push_back(init_channel(i, sizeof(T) * channel.size(), channel.data(), size, !(std::is_same<T, uvec4>::value)));
   }
-  InitChannel<i + 1>(channels...);
+  InitChannel<i + 1>(buffers, channels...);
 }
 
 template <typename... Channel>
-MeshPtr create_mesh(const std::vector<unsigned int> &indices, const Channel &...channels)
+MeshPtr create_mesh(const char *name, size_t cpu_bytes, const std::vector<unsigned int> &indices, const Channel &...channels)
 {
   uint32_t vertexArrayBufferObject;
   glGenVertexArrays(1, &vertexArrayBufferObject);
   glBindVertexArray(vertexArrayBufferObject);
-  InitChannel<0>(channels...);
-  create_indices(indices);
-  return std::make_shared<Mesh>(vertexArrayBufferObject, indices.size());
+  std::vector<uint32_t> buffers;
+  InitChannel<0>(buffers, channels...);
+  buffers.push_back(create_indices(indices));
+  auto mesh = std::make_shared<Mesh>(vertexArrayBufferObject, indices.size());
+  mesh->buffers = std::move(buffers);
+
+  size_t gpuBytes = sizeof(indices[0]) * indices.size();
+  ((gpuBytes += sizeof(typename Channel::value_type) * channels.size()), ...);
+  track_resource(ResourceType::Mesh, (uintptr_t)mesh.get(), name, cpu_bytes, gpuBytes);
+  return mesh;
 }
 
-MeshPtr create_mesh(const aiMesh *mesh, const SkeletonPtr &skeleton_)
+// Single interleaved buffer in the packed format of vertex_format.h.
+static MeshPtr create_packed_mesh(const char *name, size_t cpu_bytes, const std::vector<uint32_t> &indices, const MeshData &data)
+{
+  const PackedVertices packed = pack_vertices(data);
+  uint32_t vertexArrayBufferObject;
+  glGenVertexArrays(1, &vertexArrayBufferObject);
+  glBindVertexArray(vertexArrayBufferObject);
+
+  GLuint arrayBuffer;
+  glGenBuffers(1, &arrayBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, arrayBuffer);
+  glBufferData(GL_ARRAY_BUFFER, packed.bytes.size(), packed.bytes.data(), GL_STATIC_DRAW);
+  const GLsizei stride = packed.stride;
+  for (int i = 0; i < 5; i++)
+    glEnableVertexAttribArray(i);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)PackedPositionOffset);
+  glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void *)PackedNormalOffset);
+  glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)PackedUVOffset);
+  glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)PackedWeightsOffset);
+  glVertexAttribIPointer(4, 4, packed.shortJoints ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, stride, (void *)PackedJointsOffset);
+
+  const bool shortIndices = data.vertices.size() <= 65536;
+  size_t gpuBytes = packed.bytes.size();
+  GLuint indexBuffer;
+  if (shortIndices)
+  {
+    std::vector<uint16_t> shortIndexData(indices.begin(), indices.end());
+    indexBuffer = create_indices(shortIndexData);
+    gpuBytes += sizeof(uint16_t) * indices.size();
+  }
+  else
+  {
+    indexBuffer = create_indices(indices);
+    gpuBytes += sizeof(uint32_t) * indices.size();
+  }
+  auto mesh = std::make_shared<Mesh>(vertexArrayBufferObject, indices.size());
+  mesh->shortIndices = shortIndices;
+  mesh->buffers = {arrayBuffer, indexBuffer};
+  track_resource(ResourceType::Mesh, (uintptr_t)mesh.get(), name, cpu_bytes, gpuBytes);
+  return mesh;
+}
+
+Mesh::~Mesh()
+{
+  glDeleteBuffers(buffers.size(), buffers.data());
+  glDeleteVertexArrays(1, &vertexArrayBufferObject);
+  untrack_resource(ResourceType::Mesh, (uintptr_t)this);
+}
+
+MeshData create_mesh_data(const aiMesh *mesh, const SkeletonPtr &skeleton_)
 {
   debug_log("mesh name %s", mesh->mName.C_Str());
-  std::vector<uint32_t> indices;
-  std::vector<vec3> vertices;
-  std::vector<vec3> normals;
-  std::vector<vec2> uv;
-  std::vector<vec4> weights;
-  std::vector<uvec4> weightsIndex;
+  MeshData data;
+  data.name = mesh->mName.C_Str();
+  std::vector<uint32_t> &indices = data.indices;
+  std::vector<vec3> &vertices = data.vertices;
+  std::vector<vec3> &normals = data.normals;
+  std::vector<vec2> &uv = data.uv;
+  std::vector<vec4> &weights = data.weights;
+  std::vector<uvec4> &weightsIndex = data.weightsIndex;
 
   int numVert = mesh->mNumVertices;
   int numFaces = mesh->mNumFaces;
@@ -106,8 +175,8 @@ MeshPtr create_mesh(const aiMesh *mesh, const SkeletonPtr &skeleton_)
       uv[i] = to_vec2(mesh->mTextureCoords[0][i]);
   }
 
-  std::vector<ozz::math::Float4x4> invBindPose;
-  int rootJoint = -1;
+  std::vector<ozz::math::Float4x4> &invBindPose = data.invBindPose;
+  int &rootJoint = data.rootJoint;
   if (mesh->HasBones() && skeleton_)
   {
     const auto &skeleton = skeleton_->skeleton;
@@ -122,6 +191,9 @@ MeshPtr create_mesh(const aiMesh *mesh, const SkeletonPtr &skeleton_)
       int idx = ozz::animation::FindJoint(*skeleton, bone->mName.C_Str());
       // debug_log("%d) bone name %s", i, bone->mName.C_Str());
       boneRemap[i] = idx;
+      // pruned away, it has no weights
+      if (idx < 0)
+        continue;
       auto tm = bone->mOffsetMatrix;
       tm.Transpose();
 
@@ -172,26 +244,104 @@ MeshPtr create_mesh(const aiMesh *mesh, const SkeletonPtr &skeleton_)
       float s = w.x + w.y + w.z + w.w;
       weights[i] *= 1.f / s;
     }
+
+    // bone space box of the influenced vertices, it bounds the skin around the animated joint
+    std::vector<BoneBounds> &boneBounds = data.boneBounds;
+    boneBounds.resize(skeleton->num_joints());
+    for (int i = 0; i < numBones && !vertices.empty(); i++)
+    {
+      const aiBone *bone = mesh->mBones[i];
+      int idx = boneRemap[i];
+      if (idx < 0)
+        continue;
+      for (unsigned j = 0; j < bone->mNumWeights; j++)
+      {
+        if (bone->mWeights[j].mWeight <= 0.f)
+          continue;
+        const vec3 &v = vertices[bone->mWeights[j].mVertexId];
+        ozz::math::SimdFloat4 p = ozz::math::TransformPoint(invBindPose[idx], ozz::math::simd_float4::Load(v.x, v.y, v.z, 1.f));
+        vec3 local(ozz::math::GetX(p), ozz::math::GetY(p), ozz::math::GetZ(p));
+        boneBounds[idx].boxMin = min(boneBounds[idx].boxMin, local);
+        boneBounds[idx].boxMax = max(boneBounds[idx].boxMax, local);
+      }
+    }
   }
-  auto meshPtr = create_mesh(indices, vertices, normals, uv, weights, weightsIndex);
+  return data;
+}
+
+// Appends the simplified levels to indices, each one from the previous level.
+static std::vector<MeshLod> build_lods(const MeshData &data, std::vector<uint32_t> &indices)
+{
+  std::vector<MeshLod> lods = {{0, (int)indices.size(), 0.f}};
+  if (data.vertices.empty())
+    return lods;
+  STARTUP_SCOPE("simplify_mesh", data.name.c_str());
+  std::vector<uint32_t> lod = data.indices;
+  for (int level = 1; level < MeshLodCount; level++)
+  {
+    float error = 0.f;
+    lod = simplify_mesh(data, lod, lod.size() / 6 * 3, &error);
+    // simplification stalled on locked seams, the level wouldn't save enough
+    if (lod.empty() || lod.size() * 4 > (size_t)lods.back().numIndices * 3)
+      break;
+    optimize_vertex_cache(lod, data.vertices.size());
+    lods.push_back({(int)indices.size(), (int)lod.size(), error});
+    indices.insert(indices.end(), lod.begin(), lod.end());
+    debug_log("mesh %s lod %d: %d triangles, error %f", data.name.c_str(), level, int(lod.size() / 3), error);
+  }
+  return lods;
+}
 
-  meshPtr->rootJoint = rootJoint;
-  meshPtr->invBindPose = std::move(invBindPose);
+MeshPtr create_mesh(const MeshData &data)
+{
+  PROBE2(create_mesh_entry, data.vertices.size(), data.indices.size());
+  const char *name = data.name.empty() ? "mesh" : data.name.c_str();
+  const size_t cpuBytes = sizeof(ozz::math::Float4x4) * data.invBindPose.size() + sizeof(BoneBounds) * data.boneBounds.size();
+  std::vector<uint32_t> indices = data.indices;
+  std::vector<MeshLod> lods = build_lods(data, indices);
+  auto meshPtr = create_packed_mesh(name, cpuBytes, indices, data);
+
+  meshPtr->lods = std::move(lods);
+  meshPtr->rootJoint = data.rootJoint;
+  meshPtr->invBindPose = data.invBindPose;
+  meshPtr->boneBounds = data.boneBounds;
+  PROBE1(create_mesh_return, meshPtr->numIndices);
 
   return meshPtr;
 }
 
+MeshPtr create_mesh(const aiMesh *mesh, const SkeletonPtr &skeleton_)
+{
+  MeshData data = create_mesh_data(mesh, skeleton_);
+  {
+    STARTUP_SCOPE("optimize_mesh", data.name.c_str());
+    optimize_mesh(data);
+  }
+  return create_mesh(data);
+}
+
 
 void render(const MeshPtr &mesh)
 {
+  render_lod(mesh, 0);
+}
+
+void render_lod(const MeshPtr &mesh, int lod)
+{
+  const MeshLod &range = mesh->lods[std::clamp(lod, 0, (int)mesh->lods.size() - 1)];
+  const size_t indexSize = mesh->shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
   glBindVertexArray(mesh->vertexArrayBufferObject);
-  glDrawElementsBaseVertex(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0, 0);
+  glDrawElementsBaseVertex(GL_TRIANGLES, range.numIndices, mesh->shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                           (void *)(indexSize * range.firstIndex), 0);
+  add_counter(FrameCounter::DrawCalls);
 }
 
 void render(const MeshPtr &mesh, int count)
 {
   glBindVertexArray(mesh->vertexArrayBufferObject);
-  glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh->numIndices, GL_UNSIGNED_INT, 0, count, 0);
+  glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh->lods[0].numIndices, mesh->shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                                    0, count, 0);
+  add_counter(FrameCounter::DrawCalls);
 }
 
 MeshPtr make_plane_mesh()
@@ -200,10 +350,10 @@ MeshPtr make_plane_mesh()
   std::vector<vec3> vertices = {vec3(-1, 0, -1), vec3(1, 0, -1), vec3(1, 0, 1), vec3(-1, 0, 1)};
   std::vector<vec3> normals(4, vec3(0, 1, 0));
   std::vector<vec2> uv = {vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1)};
-  return create_mesh(indices, vertices, normals, uv);
+  return create_mesh("plane", 0, indices, vertices, normals, uv);
 }
 
 MeshPtr make_mesh(const std::vector<uint32_t> &indices, const std::vector<vec3> &vertices, const std::vector<vec3> &normals)
 {
-  return create_mesh(indices, vertices, normals);
+  return create_mesh("debug_mesh", 0, indices, vertices, normals);
 }
@@ -3,29 +3,80 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <cfloat>
 #include <3dmath.h>
 #include "ozz/base/maths/simd_math.h"
 
+// Bone space box of the skin bound to a joint, empty for joints without weights.
+struct BoneBounds
+{
+  vec3 boxMin = vec3(FLT_MAX);
+  vec3 boxMax = vec3(-FLT_MAX);
+
+  bool empty() const { return boxMin.x > boxMax.x; }
+};
+
+// Range of the index buffer drawn at one level of detail.
+struct MeshLod
+{
+  int firstIndex;
+  int numIndices;
+  // max distance of the simplified surface from the full one, in mesh units
+  float error;
+};
+
+constexpr int MeshLodCount = 4;
 
 struct Mesh
 {
   const uint32_t vertexArrayBufferObject;
+  // vertex buffers and the index buffer, deleted with the mesh
+  std::vector<uint32_t> buffers;
+  // all levels of detail share one index buffer and the vertex buffers
   const int numIndices;
+  // 16 bit index buffer, used when the vertex count allows
+  bool shortIndices = false;
+  // lods[0] is the full mesh, every next level has about half the triangles
+  std::vector<MeshLod> lods;
 
   std::vector<ozz::math::Float4x4> invBindPose;
+  // Per skeleton joint, transformed by the model space pose they bound the animated skin in O(joints).
+  std::vector<BoneBounds> boneBounds;
 
   int rootJoint = -1;
 
   Mesh(uint32_t vertexArrayBufferObject, int numIndices) :
     vertexArrayBufferObject(vertexArrayBufferObject),
-    numIndices(numIndices)
+    numIndices(numIndices),
+    lods({{0, numIndices, 0.f}})
     {}
+  ~Mesh();
 };
 
 using MeshPtr = std::shared_ptr<Mesh>;
 
+// CPU side mesh as converted at import, before it is uploaded to GPU.
+struct MeshData
+{
+  std::string name;
+  std::vector<uint32_t> indices;
+  std::vector<vec3> vertices;
+  std::vector<vec3> normals;
+  std::vector<vec2> uv;
+  std::vector<vec4> weights;
+  std::vector<uvec4> weightsIndex;
+
+  std::vector<ozz::math::Float4x4> invBindPose;
+  std::vector<BoneBounds> boneBounds;
+  int rootJoint = -1;
+};
+
+MeshPtr create_mesh(const MeshData &data);
+
 MeshPtr make_plane_mesh();
 MeshPtr make_mesh(const std::vector<uint32_t> &indices, const std::vector<vec3> &vertices, const std::vector<vec3> &normals);
 
 void render(const MeshPtr &mesh);
-void render(const MeshPtr &mesh, int count);
\ No newline at end of file
+void render(const MeshPtr &mesh, int count);
+// Draws the level clamped to the available ones.
+void render_lod(const MeshPtr &mesh, int lod);
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "mesh_optimize.h"
+#include <log.h>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+template <typename T>
+static int compare_attribute(const std::vector<T> &channel, uint32_t a, uint32_t b)
+{
+  return channel.empty() ? 0 : memcmp(&channel[a], &channel[b], sizeof(T));
+}
+
+template <typename T>
+static void remap_channel(std::vector<T> &channel, const std::vector<uint32_t> &remap, size_t new_count)
+{
+  if (channel.empty())
+    return;
+  std::vector<T> result(new_count);
+  for (size_t i = 0; i < remap.size(); i++)
+    if (remap[i] != ~0u)
+      result[remap[i]] = channel[i];
+  channel.swap(result);
+}
+
+void weld_vertices(MeshData &data)
+{
+  const uint32_t vertexCount = data.vertices.size();
+  std::vector<uint32_t> order(vertexCount);
+  std::iota(order.begin(), order.end(), 0);
+  auto compare = [&](uint32_t a, uint32_t b)
+  {
+    int c = compare_attribute(data.vertices, a, b);
+    if (!c) c = compare_attribute(data.normals, a, b);
+    if (!c) c = compare_attribute(data.uv, a, b);
+    if (!c) c = compare_attribute(data.weights, a, b);
+    if (!c) c = compare_attribute(data.weightsIndex, a, b);
+    return c;
+  };
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+  {
+    int c = compare(a, b);
+    return c ? c < 0 : a < b;
+  });
+  // indices point to the first of the identical vertices, the unused ones are dropped by optimize_vertex_fetch
+  std::vector<uint32_t> remap(vertexCount);
+  for (uint32_t i = 0; i < vertexCount; i++)
+    remap[order[i]] = i > 0 && compare(order[i - 1], order[i]) == 0 ? remap[order[i - 1]] : order[i];
+  for (uint32_t &index : data.indices)
+    index = remap[index];
+}
+
+// Live triangles of v bring it back into the cache soon, Tipsify picks the next fanning vertex from the
+// candidates which will still be cached after emitting them.
+static int next_vertex(const std::vector<uint32_t> &candidates, const std::vector<int> &live,
+                       const std::vector<int> &timestamp, int time, int cache_size,
+                       std::vector<uint32_t> &dead_end, uint32_t &cursor)
+{
+  int best = -1, bestPriority = -1;
+  for (uint32_t v : candidates)
+  {
+    if (live[v] <= 0)
+      continue;
+    int priority = 0;
+    if (time - timestamp[v] + 2 * live[v] <= cache_size)
+      priority = time - timestamp[v];
+    if (priority > bestPriority)
+    {
+      bestPriority = priority;
+      best = v;
+    }
+  }
+  if (best >= 0)
+    return best;
+  while (!dead_end.empty())
+  {
+    uint32_t v = dead_end.back();
+    dead_end.pop_back();
+    if (live[v] > 0)
+      return v;
+  }
+  for (; cursor < live.size(); cursor++)
+    if (live[cursor] > 0)
+      return cursor;
+  return -1;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count, int cache_size)
+{
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  std::vector<int> live(vertex_count, 0);
+  for (uint32_t v : indices)
+    live[v]++;
+  std::vector<uint32_t> offset(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; v++)
+    offset[v + 1] = offset[v] + live[v];
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+      adjacency[fill[indices[i]]++] = i / 3;
+  }
+
+  std::vector<int> timestamp(vertex_count, 0);
+  std::vector<uint8_t> emitted(triangleCount, 0);
+  std::vector<uint32_t> deadEnd, candidates, result;
+  result.reserve(indices.size());
+  int time = cache_size + 1;
+  uint32_t cursor = 0;
+  int fanning = next_vertex(candidates, live, timestamp, time, cache_size, deadEnd, cursor);
+  while (fanning >= 0)
+  {
+    candidates.clear();
+    for (uint32_t i = offset[fanning]; i < offset[fanning + 1]; i++)
+    {
+      const uint32_t t = adjacency[i];
+      if (emitted[t])
+        continue;
+      emitted[t] = 1;
+      for (int k = 0; k < 3; k++)
+      {
+        const uint32_t v = indices[t * 3 + k];
+        result.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - timestamp[v] > cache_size)
+          timestamp[v] = time++;
+      }
+    }
+    fanning = next_vertex(candidates, live, timestamp, time, cache_size, deadEnd, cursor);
+  }
+  indices.swap(result);
+}
+
+void optimize_vertex_fetch(MeshData &data)
+{
+  std::vector<uint32_t> remap(data.vertices.size(), ~0u);
+  uint32_t next = 0;
+  for (uint32_t &index : data.indices)
+  {
+    if (remap[index] == ~0u)
+      remap[index] = next++;
+    index = remap[index];
+  }
+  remap_channel(data.vertices, remap, next);
+  remap_channel(data.normals, remap, next);
+  remap_channel(data.uv, remap, next);
+  remap_channel(data.weights, remap, next);
+  remap_channel(data.weightsIndex, remap, next);
+}
+
+float compute_acmr(const std::vector<uint32_t> &indices, size_t vertex_count, int cache_size)
+{
+  if (indices.size() < 3)
+    return 0.f;
+  // position of the vertex in the fifo by the miss counter value when it was pushed
+  std::vector<int64_t> pushed(vertex_count, -int64_t(cache_size) - 1);
+  int64_t misses = 0;
+  for (uint32_t v : indices)
+    if (misses - pushed[v] > cache_size)
+      pushed[v] = misses++;
+  return float(misses) / (indices.size() / 3);
+}
+
+void optimize_mesh(MeshData &data)
+{
+  if (data.vertices.empty() || data.indices.empty())
+    return;
+  const size_t vertexCount = data.vertices.size();
+  const float acmr = compute_acmr(data.indices, vertexCount);
+
+  weld_vertices(data);
+  optimize_vertex_cache(data.indices, vertexCount);
+  optimize_vertex_fetch(data);
+
+  debug_log("mesh %s: %d -> %d vertices, ACMR %.3f -> %.3f", data.name.c_str(), int(vertexCount), int(data.vertices.size()),
+            acmr, compute_acmr(data.indices, data.vertices.size()));
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "mesh.h"
+
+// Merges vertices with identical position, normal, uv and skin data.
+void weld_vertices(MeshData &data);
+
+// Reorders triangles for post-transform cache hits (Tipsify, Sander et al. 2007).
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count, int cache_size = 16);
+
+// Reorders vertices by first use in the index buffer and drops unused ones.
+void optimize_vertex_fetch(MeshData &data);
+
+// Average cache miss ratio, transformed vertices per triangle with a FIFO cache of cache_size.
+float compute_acmr(const std::vector<uint32_t> &indices, size_t vertex_count, int cache_size = 16);
+
+// All of the above in order, logs vertex count and ACMR before and after.
+void optimize_mesh(MeshData &data);
@@ -0,0 +1,184 @@
+#include "occlusion.h"
+#include <parallel.h>
+#include <algorithm>
+#include <cfloat>
+#include "ozz/base/maths/simd_math.h"
+
+static constexpr int BandRows = 8;
+
+void occlusion_begin(OcclusionBuffer &buffer, int width, int height, const mat4 &proj_view)
+{
+  buffer.width = (width + 3) & ~3;
+  buffer.height = height;
+  buffer.projView = proj_view;
+  buffer.depth.assign(buffer.width * buffer.height, 1.f);
+  buffer.triangles.clear();
+}
+
+// Pixel coordinates and [0, 1] depth, false for points behind the near plane.
+static bool project(const OcclusionBuffer &buffer, const vec3 &p, vec3 &result)
+{
+  const vec4 clip = buffer.projView * vec4(p, 1.f);
+  if (clip.w <= 1e-4f || clip.z < -clip.w)
+    return false;
+  const vec3 ndc = vec3(clip) / clip.w;
+  result = vec3((ndc.x * 0.5f + 0.5f) * buffer.width, (ndc.y * 0.5f + 0.5f) * buffer.height, ndc.z * 0.5f + 0.5f);
+  return true;
+}
+
+static bool project_points(const OcclusionBuffer &buffer, const vec3 points[8], vec3 corners[8])
+{
+  for (int i = 0; i < 8; i++)
+    if (!project(buffer, points[i], corners[i]))
+      return false;
+  return true;
+}
+
+static void box_points(const vec3 &box_min, const vec3 &box_max, vec3 points[8])
+{
+  for (int i = 0; i < 8; i++)
+    points[i] = vec3((i & 1) ? box_max.x : box_min.x, (i & 2) ? box_max.y : box_min.y, (i & 4) ? box_max.z : box_min.z);
+}
+
+static bool project_box(const OcclusionBuffer &buffer, const vec3 &box_min, const vec3 &box_max, vec3 corners[8])
+{
+  vec3 points[8];
+  box_points(box_min, box_max, points);
+  return project_points(buffer, points, corners);
+}
+
+// corners are ordered like box_points
+static void add_box_triangles(OcclusionBuffer &buffer, const vec3 corners[8])
+{
+  static const int faces[6][4] = {{0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}};
+  for (const int *face : faces)
+  {
+    buffer.triangles.insert(buffer.triangles.end(), {corners[face[0]], corners[face[1]], corners[face[2]]});
+    buffer.triangles.insert(buffer.triangles.end(), {corners[face[0]], corners[face[2]], corners[face[3]]});
+  }
+}
+
+void occlusion_add_box(OcclusionBuffer &buffer, const vec3 &box_min, const vec3 &box_max)
+{
+  vec3 corners[8];
+  if (project_box(buffer, box_min, box_max, corners))
+    add_box_triangles(buffer, corners);
+}
+
+void occlusion_add_oriented_box(OcclusionBuffer &buffer, const mat4 &tm, const vec3 &box_min, const vec3 &box_max)
+{
+  vec3 points[8], corners[8];
+  box_points(box_min, box_max, points);
+  for (vec3 &p : points)
+    p = vec3(tm * vec4(p, 1.f));
+  if (project_points(buffer, points, corners))
+    add_box_triangles(buffer, corners);
+}
+
+// Edge function a * x + b * y + c, positive on the inner side of a counter clockwise edge.
+struct Edge
+{
+  float a, b, c;
+  Edge(const vec3 &from, const vec3 &to) : a(from.y - to.y), b(to.x - from.x), c(-(a * from.x + b * from.y)) {}
+};
+
+static void rasterize_triangle(OcclusionBuffer &buffer, vec3 v0, vec3 v1, vec3 v2, int row_begin, int row_end)
+{
+  float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+  if (fabsf(area) < 1e-6f)
+    return;
+  // both windings are drawn, box faces are not culled
+  if (area < 0.f)
+  {
+    std::swap(v1, v2);
+    area = -area;
+  }
+  int minX = std::max(0, (int)floorf(std::min({v0.x, v1.x, v2.x})));
+  int maxX = std::min(buffer.width - 1, (int)ceilf(std::max({v0.x, v1.x, v2.x})));
+  int minY = std::max(row_begin, (int)floorf(std::min({v0.y, v1.y, v2.y})));
+  int maxY = std::min(row_end - 1, (int)ceilf(std::max({v0.y, v1.y, v2.y})));
+  if (minX > maxX || minY > maxY)
+    return;
+  minX &= ~3;
+
+  const Edge e0(v1, v2), e1(v2, v0), e2(v0, v1);
+  // depth is affine in screen space, weights of v0, v1 and v2 are e0, e1 and e2 over the area
+  const float invArea = 1.f / area;
+  const float za = (e0.a * v0.z + e1.a * v1.z + e2.a * v2.z) * invArea;
+  const float zb = (e0.b * v0.z + e1.b * v1.z + e2.b * v2.z) * invArea;
+  const float zc = (e0.c * v0.z + e1.c * v1.z + e2.c * v2.z) * invArea;
+
+  using namespace ozz::math;
+  const SimdFloat4 zero = simd_float4::zero();
+  const SimdFloat4 offsets = simd_float4::Load(0.5f, 1.5f, 2.5f, 3.5f);
+  const SimdFloat4 a0 = simd_float4::Load1(e0.a), a1 = simd_float4::Load1(e1.a), a2 = simd_float4::Load1(e2.a);
+  const SimdFloat4 zA = simd_float4::Load1(za);
+  for (int y = minY; y <= maxY; y++)
+  {
+    const float py = y + 0.5f;
+    const SimdFloat4 row0 = simd_float4::Load1(e0.b * py + e0.c);
+    const SimdFloat4 row1 = simd_float4::Load1(e1.b * py + e1.c);
+    const SimdFloat4 row2 = simd_float4::Load1(e2.b * py + e2.c);
+    const SimdFloat4 rowZ = simd_float4::Load1(zb * py + zc);
+    float *row = buffer.depth.data() + y * buffer.width;
+    for (int x = minX; x <= maxX; x += 4)
+    {
+      const SimdFloat4 px = simd_float4::Load1(float(x)) + offsets;
+      const SimdFloat4 w = Min(MAdd(a0, px, row0), Min(MAdd(a1, px, row1), MAdd(a2, px, row2)));
+      const SimdInt4 outside = CmpLt(w, zero);
+      if (MoveMask(outside) == 0xf)
+        continue;
+      const SimdFloat4 current = simd_float4::LoadPtrU(row + x);
+      StorePtrU(Select(outside, current, Min(current, MAdd(zA, px, rowZ))), row + x);
+    }
+  }
+}
+
+void occlusion_rasterize(OcclusionBuffer &buffer)
+{
+  const int bands = (buffer.height + BandRows - 1) / BandRows;
+  const int triangleCount = buffer.triangles.size() / 3;
+  parallel_for(bands, 1, [&](int begin, int end)
+  {
+    for (int band = begin; band < end; band++)
+    {
+      const int rowBegin = band * BandRows;
+      const int rowEnd = std::min(rowBegin + BandRows, buffer.height);
+      for (int i = 0; i < triangleCount; i++)
+      {
+        const vec3 *v = &buffer.triangles[i * 3];
+        rasterize_triangle(buffer, v[0], v[1], v[2], rowBegin, rowEnd);
+      }
+    }
+  });
+}
+
+bool occlusion_test_box(const OcclusionBuffer &buffer, const vec3 &box_min, const vec3 &box_max)
+{
+  vec3 corners[8];
+  if (!project_box(buffer, box_min, box_max, corners))
+    return true;
+  vec3 lo(FLT_MAX), hi(-FLT_MAX);
+  for (const vec3 &corner : corners)
+  {
+    lo = min(lo, corner);
+    hi = max(hi, corner);
+  }
+  const int minX = std::max(0, (int)floorf(lo.x)) & ~3;
+  const int maxX = std::min(buffer.width - 1, (int)ceilf(hi.x));
+  const int minY = std::max(0, (int)floorf(lo.y));
+  const int maxY = std::min(buffer.height - 1, (int)ceilf(hi.y));
+  if (minX > maxX || minY > maxY)
+    return true;
+
+  using namespace ozz::math;
+  const SimdFloat4 nearest = simd_float4::Load1(lo.z);
+  for (int y = minY; y <= maxY; y++)
+  {
+    const float *row = buffer.depth.data() + y * buffer.width;
+    for (int x = minX; x <= maxX; x += 4)
+      if (MoveMask(CmpLt(simd_float4::LoadPtrU(row + x), nearest)) != 0xf)
+        return true;
+  }
+  return false;
+}
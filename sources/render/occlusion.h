@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include <3dmath.h>
+
+// Low resolution depth buffer of occluder boxes, rasterized on the CPU and tested against occludee boxes.
+struct OcclusionBuffer
+{
+  int width = 0;
+  int height = 0;
+  mat4 projView;
+  // nearest occluder depth per pixel in [0, 1], 1 is the far plane
+  std::vector<float> depth;
+  // occluder triangles in pixel coordinates, three vertices each
+  std::vector<vec3> triangles;
+};
+
+// Clears the buffer, width is rounded up to a multiple of 4.
+void occlusion_begin(OcclusionBuffer &buffer, int width, int height, const mat4 &proj_view);
+// The box must lie inside the geometry it stands for, boxes crossing the near plane are skipped.
+void occlusion_add_box(OcclusionBuffer &buffer, const vec3 &box_min, const vec3 &box_max);
+// Same for a box given in the space of tm, it is rasterized as the transformed box and not its bounds.
+void occlusion_add_oriented_box(OcclusionBuffer &buffer, const mat4 &tm, const vec3 &box_min, const vec3 &box_max);
+// Rasterizes the added boxes, bands of rows are split between the workers.
+void occlusion_rasterize(OcclusionBuffer &buffer);
+// False when every pixel the box covers has a nearer occluder. Safe to call from several threads.
+bool occlusion_test_box(const OcclusionBuffer &buffer, const vec3 &box_min, const vec3 &box_max);
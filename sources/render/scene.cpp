@@ -4,40 +4,53 @@
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <log.h>
+#include <startup.h>
+#include <probes.h>
 
-
-MeshPtr create_mesh(const aiMesh *mesh, const SkeletonPtr &skeleton);
-SkeletonPtr create_skeleton(const aiNode &ai_node);
-AnimationPtr create_animation(const aiAnimation &ai_animation, const SkeletonPtr &skeleton, bool build_as_additive);
-
-SceneAsset load_scene(const char *path, int load_flags, SkeletonPtr ref_pos)
+const aiScene *read_scene(Assimp::Importer &importer, const char *path)
 {
-  Assimp::Importer importer;
+  STARTUP_SCOPE("read_scene");
+  startup_add_file_read(path);
   importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
   importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 1.f);
 
   importer.ReadFile(path, aiPostProcessSteps::aiProcess_Triangulate | aiPostProcessSteps::aiProcess_LimitBoneWeights |
     aiPostProcessSteps::aiProcess_GenNormals | aiProcess_GlobalScale | aiProcess_FlipWindingOrder);
 
-  const aiScene* scene = importer.GetScene();
+  return importer.GetScene();
+}
+
+SceneAsset load_scene(const char *path, int load_flags, SkeletonPtr ref_pos, const std::vector<std::string> &keep_joints)
+{
+  STARTUP_SCOPE("load_scene", path);
+  PROBE2(load_scene_entry, path, load_flags);
+  Assimp::Importer importer;
+  const aiScene* scene = read_scene(importer, path);
   SceneAsset result;
   if (!scene)
   {
     debug_error("no asset in %s", path);
+    PROBE2(load_scene_return, 0, 0);
     return result;
   }
   if (load_flags & SceneAsset::LoadScene::Skeleton)
   {
-    result.skeleton = create_skeleton(*scene->mRootNode);
+    STARTUP_SCOPE("create_skeleton");
+    if (load_flags & SceneAsset::LoadScene::PruneSkeleton)
+      result.skeleton = create_skeleton(*scene, keep_joints);
+    else
+      result.skeleton = create_skeleton(*scene->mRootNode);
   }
   if (load_flags & SceneAsset::LoadScene::Meshes)
   {
+    STARTUP_SCOPE("create_mesh");
     result.meshes.reserve(scene->mNumMeshes);
     for (size_t i = 0; i < scene->mNumMeshes; i++)
       result.meshes.emplace_back(create_mesh(scene->mMeshes[i], result.skeleton));
   }
   if (load_flags & SceneAsset::LoadScene::Animation && result.skeleton)
   {
+    STARTUP_SCOPE("create_animation");
     result.animations.reserve(scene->mNumAnimations);
     for (size_t i = 0; i < scene->mNumAnimations; i++)
       if (AnimationPtr animation = create_animation(*scene->mAnimations[i], ref_pos ? ref_pos : result.skeleton, false))
@@ -45,6 +58,7 @@ SceneAsset load_scene(const char *path, int load_flags, SkeletonPtr ref_pos)
   }
   if (load_flags & SceneAsset::LoadScene::AdditiveAnimation && result.skeleton)
   {
+    STARTUP_SCOPE("create_additive_animation");
     result.animations.reserve(scene->mNumAnimations);
     for (size_t i = 0; i < scene->mNumAnimations; i++)
       if (AnimationPtr animation = create_animation(*scene->mAnimations[i], ref_pos ? ref_pos : result.skeleton, true))
@@ -52,5 +66,6 @@ SceneAsset load_scene(const char *path, int load_flags, SkeletonPtr ref_pos)
   }
 
   importer.FreeScene();
+  PROBE2(load_scene_return, result.meshes.size(), result.animations.size());
   return result;
 }
\ No newline at end of file
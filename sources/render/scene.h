@@ -4,12 +4,26 @@
 #include "ozz/base/maths/simd_math.h"
 
 
+struct aiScene;
+struct aiNode;
+struct aiMesh;
+struct aiAnimation;
+namespace Assimp
+{
+  class Importer;
+}
+
 namespace ozz
 {
   namespace animation
   {
     class Skeleton;
     class Animation;
+    namespace offline
+    {
+      struct RawSkeleton;
+      struct RawAnimation;
+    }
   }
 }
 
@@ -34,7 +48,20 @@ struct SceneAsset
     Skeleton = 1 << 1,
     Animation = 1 << 2,
     AdditiveAnimation = 1 << 3,
+    // Skeleton keeps only skinned joints, their ancestors and keep_joints. Meshes and clips bind joints by name,
+    // so they follow the pruned skeleton.
+    PruneSkeleton = 1 << 4,
   };
 };
 
-SceneAsset load_scene(const char *path, int load_flags, SkeletonPtr ref_pos = nullptr);
\ No newline at end of file
+SceneAsset load_scene(const char *path, int load_flags, SkeletonPtr ref_pos = nullptr, const std::vector<std::string> &keep_joints = {});
+
+// Import stages of load_scene, exposed for tools and benchmarks.
+const aiScene *read_scene(Assimp::Importer &importer, const char *path);
+SkeletonPtr create_skeleton(const aiNode &ai_node);
+SkeletonPtr create_skeleton(const aiScene &scene, const std::vector<std::string> &keep_joints);
+SkeletonPtr create_skeleton(const ozz::animation::offline::RawSkeleton &raw_skeleton);
+AnimationPtr create_animation(const aiAnimation &ai_animation, const SkeletonPtr &skeleton, bool build_as_additive);
+AnimationPtr create_animation(const ozz::animation::offline::RawAnimation &raw_animation, const SkeletonPtr &skeleton, bool build_as_additive);
+MeshData create_mesh_data(const aiMesh *mesh, const SkeletonPtr &skeleton);
+MeshPtr create_mesh(const aiMesh *mesh, const SkeletonPtr &skeleton);
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <map>
 #include "log.h"
+#include <startup.h>
+#include <probes.h>
 #include "glad/glad.h"
 #include <filesystem>
 #include <array>
@@ -85,24 +87,30 @@ static bool compile_shader(const char *shaderName, const std::vector<ShaderInfo>
 static std::string read_file(const char *path)
 {
   std::ifstream file(path);
-  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  std::string text(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+  startup_add_bytes_read(text.size());
+  return text;
 }
 
 static bool compile_shader(const char *name, const Shader::ShaderSources &sources, GLuint &program)
 {
   std::vector<ShaderInfo> shaderCode;
 
+  PROBE1(compile_shader_entry, name);
   for (const auto &[shaderType, path] : sources)
   {
     shaderCode.emplace_back(ShaderInfo{shaderType, path, read_file(path.c_str())});
   }
-  return compile_shader(name, shaderCode, program);
+  bool compiled = compile_shader(name, shaderCode, program);
+  PROBE2(compile_shader_return, name, compiled);
+  return compiled;
 }
 
 static std::vector<ShaderPtr> shaderList;
 
 ShaderPtr compile_shader(const char *name, const char *vs_path, const char *ps_path)
 {
+  STARTUP_SCOPE("compile_shader", name);
   Shader::ShaderSources shaderSources{{GL_VERTEX_SHADER, vs_path}, {GL_FRAGMENT_SHADER, ps_path}};
 
   GLuint program;
@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include "glad/glad.h"
+#include <counters.h>
 #include <span>
 
 
@@ -35,6 +36,7 @@ public:
 	void use() const
 	{
 		glUseProgram(program);
+		add_counter(FrameCounter::ProgramBinds);
 	}
 
 	int get_uniform_location(const char *name)
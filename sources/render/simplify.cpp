@@ -0,0 +1,250 @@
+#include "simplify.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+// Symmetric 4x4 matrix of summed plane equations, v^T Q v is the squared distance to the planes.
+struct Quadric
+{
+  double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+  void add_plane(const dvec3 &n, double d, double weight)
+  {
+    a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+    b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+    c2 += weight * n.z * n.z; cd += weight * n.z * d;
+    d2 += weight * d * d;
+  }
+  void add(const Quadric &q)
+  {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2; bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+  }
+  double error(const vec3 &v) const
+  {
+    const double x = v.x, y = v.y, z = v.z;
+    return x * x * a2 + 2 * x * y * ab + 2 * x * z * ac + 2 * x * ad + y * y * b2 + 2 * y * z * bc + 2 * y * bd +
+           z * z * c2 + 2 * z * cd + d2;
+  }
+};
+
+template <typename T>
+static int compare_attribute(const std::vector<T> &channel, uint32_t a, uint32_t b)
+{
+  return channel.empty() ? 0 : memcmp(&channel[a], &channel[b], sizeof(T));
+}
+
+static int dominant_joint(const MeshData &data, uint32_t v)
+{
+  if (data.weights.empty())
+    return -1;
+  const vec4 &w = data.weights[v];
+  int best = 0;
+  for (int i = 1; i < 4; i++)
+    if (w[i] > w[best])
+      best = i;
+  return data.weightsIndex[v][best];
+}
+
+static vec3 triangle_normal(const vec3 &a, const vec3 &b, const vec3 &c)
+{
+  return cross(b - a, c - a);
+}
+
+std::vector<uint32_t> simplify_mesh(const MeshData &data, const std::vector<uint32_t> &indices, size_t target_index_count,
+                                    float *result_error)
+{
+  const std::vector<vec3> &positions = data.vertices;
+  const uint32_t vertexCount = positions.size();
+  if (result_error)
+    *result_error = 0.f;
+  if (vertexCount == 0 || indices.size() <= target_index_count)
+    return indices;
+
+  // Imported meshes may repeat a vertex per triangle, identical vertices are merged into the first of them.
+  std::vector<uint32_t> order(vertexCount);
+  std::iota(order.begin(), order.end(), 0);
+  auto comparePosition = [&](uint32_t a, uint32_t b) { return compare_attribute(positions, a, b); };
+  auto compareVertex = [&](uint32_t a, uint32_t b)
+  {
+    int c = compare_attribute(positions, a, b);
+    if (!c) c = compare_attribute(data.normals, a, b);
+    if (!c) c = compare_attribute(data.uv, a, b);
+    if (!c) c = compare_attribute(data.weights, a, b);
+    if (!c) c = compare_attribute(data.weightsIndex, a, b);
+    return c;
+  };
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+  {
+    int c = compareVertex(a, b);
+    return c ? c < 0 : a < b;
+  });
+  std::vector<uint32_t> remap(vertexCount);
+  // a position shared by several distinct vertices is a seam
+  std::vector<uint8_t> locked(vertexCount, 0);
+  for (uint32_t i = 0, groupStart = 0; i < vertexCount; i++)
+  {
+    const bool samePosition = i > 0 && comparePosition(order[i - 1], order[i]) == 0;
+    if (i > 0 && compareVertex(order[i - 1], order[i]) == 0)
+    {
+      remap[order[i]] = remap[order[i - 1]];
+      continue;
+    }
+    remap[order[i]] = order[i];
+    if (!samePosition)
+      groupStart = i;
+    else
+      for (uint32_t j = groupStart; j <= i; j++)
+        locked[remap[order[j]]] = 1;
+  }
+
+  std::vector<uint32_t> result(indices.size());
+  for (size_t i = 0; i < indices.size(); i++)
+    result[i] = remap[indices[i]];
+
+  // Open borders are locked too, their edges belong to a single triangle.
+  {
+    std::vector<uint64_t> edges;
+    edges.reserve(result.size());
+    for (size_t t = 0; t < result.size(); t += 3)
+      for (int e = 0; e < 3; e++)
+      {
+        uint32_t a = result[t + e], b = result[t + (e + 1) % 3];
+        edges.push_back(uint64_t(std::min(a, b)) << 32 | std::max(a, b));
+      }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();)
+    {
+      size_t j = i;
+      while (j < edges.size() && edges[j] == edges[i])
+        j++;
+      if (j - i == 1)
+        locked[edges[i] >> 32] = locked[edges[i] & 0xffffffff] = 1;
+      i = j;
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t t = 0; t < result.size(); t += 3)
+  {
+    const vec3 &p0 = positions[result[t]], &p1 = positions[result[t + 1]], &p2 = positions[result[t + 2]];
+    dvec3 n = dvec3(triangle_normal(p0, p1, p2));
+    const double area = length(n);
+    if (area <= 0.0)
+      continue;
+    n /= area;
+    const double d = -dot(n, dvec3(p0));
+    for (int k = 0; k < 3; k++)
+      quadrics[result[t + k]].add_plane(n, d, area);
+  }
+
+  std::vector<int> joints(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++)
+    joints[v] = dominant_joint(data, v);
+
+  struct Collapse
+  {
+    uint32_t from, to;
+    double cost;
+  };
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> adjacencyOffset, adjacency, collapseTo(vertexCount);
+  std::vector<uint8_t> touched(vertexCount);
+  double maxError = 0.0;
+
+  while (result.size() > target_index_count)
+  {
+    collapses.clear();
+    for (size_t t = 0; t < result.size(); t += 3)
+      for (int e = 0; e < 3; e++)
+      {
+        const uint32_t a = result[t + e], b = result[t + (e + 1) % 3];
+        if (joints[a] != joints[b])
+          continue;
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+        if (!locked[a])
+          collapses.push_back({a, b, q.error(positions[b])});
+        if (!locked[b])
+          collapses.push_back({b, a, q.error(positions[a])});
+      }
+    if (collapses.empty())
+      break;
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+    // vertex to triangle adjacency of this pass
+    adjacencyOffset.assign(vertexCount + 1, 0);
+    for (uint32_t v : result)
+      adjacencyOffset[v + 1]++;
+    std::partial_sum(adjacencyOffset.begin(), adjacencyOffset.end(), adjacencyOffset.begin());
+    adjacency.resize(result.size());
+    {
+      std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+      for (size_t i = 0; i < result.size(); i++)
+        adjacency[fill[result[i]]++] = i / 3;
+    }
+
+    std::iota(collapseTo.begin(), collapseTo.end(), 0);
+    std::fill(touched.begin(), touched.end(), 0);
+    size_t triangleCount = result.size() / 3;
+    const size_t targetTriangles = target_index_count / 3;
+    size_t applied = 0;
+    for (const Collapse &c : collapses)
+    {
+      if (triangleCount <= targetTriangles)
+        break;
+      if (touched[c.from] || touched[c.to])
+        continue;
+
+      // rejects collapses which flip or degenerate one of the remaining triangles
+      bool valid = true;
+      size_t removed = 0;
+      for (uint32_t i = adjacencyOffset[c.from]; i < adjacencyOffset[c.from + 1] && valid; i++)
+      {
+        const uint32_t *tri = &result[adjacency[i] * 3];
+        if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+        {
+          removed++;
+          continue;
+        }
+        vec3 p[3], q[3];
+        for (int k = 0; k < 3; k++)
+        {
+          p[k] = positions[tri[k]];
+          q[k] = tri[k] == c.from ? positions[c.to] : p[k];
+        }
+        const vec3 before = triangle_normal(p[0], p[1], p[2]);
+        const vec3 after = triangle_normal(q[0], q[1], q[2]);
+        valid = dot(before, after) > 0.25f * length(before) * length(after) && length(after) > 0.f;
+      }
+      if (!valid)
+        continue;
+
+      collapseTo[c.from] = c.to;
+      quadrics[c.to].add(quadrics[c.from]);
+      for (uint32_t i = adjacencyOffset[c.from]; i < adjacencyOffset[c.from + 1]; i++)
+        for (int k = 0; k < 3; k++)
+          touched[result[adjacency[i] * 3 + k]] = 1;
+      triangleCount -= removed;
+      maxError = std::max(maxError, c.cost);
+      applied++;
+    }
+    if (applied == 0)
+      break;
+
+    size_t write = 0;
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+      const uint32_t a = collapseTo[result[t]], b = collapseTo[result[t + 1]], c = collapseTo[result[t + 2]];
+      if (a == b || b == c || a == c)
+        continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  if (result_error)
+    *result_error = sqrt(maxError);
+  return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "mesh.h"
+
+// Edge collapse simplification with quadric error metrics, it stops once the index count reaches target_index_count
+// or no collapse is left. A collapse keeps the surviving vertex, so the result indexes data.vertices and the vertex
+// buffers are shared between levels. Vertices on UV or normal seams and open borders are locked, collapses between
+// vertices with different dominant joints are rejected to keep the skinning of joint bends.
+std::vector<uint32_t> simplify_mesh(const MeshData &data, const std::vector<uint32_t> &indices, size_t target_index_count,
+                                    float *result_error = nullptr);
@@ -1,10 +1,12 @@
 #include "texture2d.h"
 #include "glad/glad.h"
 #include <cassert>
+#include <memory_stats.h>
+#include <startup.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
-Texture2DPtr create_texture(const unsigned char *image, int w, int h, int ch)
+Texture2DPtr create_texture(const char *name, const unsigned char *image, int w, int h, int ch)
 {
   GLuint textureObject;
   glGenTextures(1, &textureObject);
@@ -36,11 +38,23 @@ Texture2DPtr create_texture(const unsigned char *image, int w, int h, int ch)
   }
   glBindTexture(textureType, 0);
 
+  // drivers keep RGB as RGBA, a full mip chain adds a third on top of the base level
+  size_t gpuBytes = size_t(w) * h * 4;
+  if (generateMips)
+    gpuBytes += gpuBytes / 3;
+  track_resource(ResourceType::Texture, (uintptr_t)texture.get(), name, 0, gpuBytes);
   return texture;
 }
 
+Texture2D::~Texture2D()
+{
+  untrack_resource(ResourceType::Texture, (uintptr_t)this);
+}
+
 Texture2DPtr create_texture2d(const char *path)
 {
+  STARTUP_SCOPE("create_texture2d", path);
+  startup_add_file_read(path);
   int w, h, ch;
   stbi_set_flip_vertically_on_load(true);
   auto stbiData = stbi_load(path, &w, &h, &ch, 0);
@@ -48,7 +62,7 @@ Texture2DPtr create_texture2d(const char *path)
   Texture2DPtr result;
   if (stbiData)
   {
-    result = create_texture(stbiData, w, h, ch);
+    result = create_texture(path, stbiData, w, h, ch);
     stbi_image_free(stbiData);
   }
   return result;
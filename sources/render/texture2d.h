@@ -6,6 +6,7 @@ struct Texture2D
 {
   const unsigned textureObject;
   Texture2D(unsigned textureObject) : textureObject(textureObject) {}
+  ~Texture2D();
 };
 
 using Texture2DPtr = std::shared_ptr<Texture2D>;
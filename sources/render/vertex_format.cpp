@@ -0,0 +1,76 @@
+#include "vertex_format.h"
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+static vec2 sign_not_zero(const vec2 &v)
+{
+  return vec2(v.x >= 0.f ? 1.f : -1.f, v.y >= 0.f ? 1.f : -1.f);
+}
+
+void encode_octahedral(const vec3 &normal, int16_t result[2])
+{
+  const vec3 n = normal / (abs(normal.x) + abs(normal.y) + abs(normal.z) + 1e-20f);
+  vec2 p = vec2(n.x, n.y);
+  if (n.z < 0.f)
+    p = (1.f - abs(vec2(p.y, p.x))) * sign_not_zero(p);
+  result[0] = (int16_t)roundf(clamp(p.x, -1.f, 1.f) * 32767.f);
+  result[1] = (int16_t)roundf(clamp(p.y, -1.f, 1.f) * 32767.f);
+}
+
+void quantize_weights(const vec4 &weights, uint8_t result[4])
+{
+  int sum = 0, largest = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    result[i] = (uint8_t)std::clamp((int)roundf(weights[i] * 255.f), 0, 255);
+    sum += result[i];
+    if (weights[i] > weights[largest])
+      largest = i;
+  }
+  // rounding error goes to the largest weight, it is the least sensitive one
+  result[largest] = (uint8_t)std::clamp(result[largest] + 255 - sum, 0, 255);
+}
+
+PackedVertices pack_vertices(const MeshData &data)
+{
+  PackedVertices result;
+  const size_t vertexCount = data.vertices.size();
+  for (const uvec4 &joints : data.weightsIndex)
+    result.shortJoints |= max(max(joints.x, joints.y), max(joints.z, joints.w)) > 255u;
+  result.stride = PackedJointsOffset + (result.shortJoints ? 8 : 4);
+  result.bytes.assign(vertexCount * result.stride, 0);
+
+  for (size_t i = 0; i < vertexCount; i++)
+  {
+    uint8_t *vertex = result.bytes.data() + i * result.stride;
+    memcpy(vertex + PackedPositionOffset, &data.vertices[i], sizeof(vec3));
+
+    int16_t normal[2] = {0, 0};
+    if (!data.normals.empty())
+      encode_octahedral(data.normals[i], normal);
+    memcpy(vertex + PackedNormalOffset, normal, sizeof(normal));
+
+    const vec2 uv = data.uv.empty() ? vec2(0.f) : data.uv[i];
+    const uint32_t halfUV = glm::packHalf2x16(uv);
+    memcpy(vertex + PackedUVOffset, &halfUV, sizeof(halfUV));
+
+    uint8_t weights[4] = {255, 0, 0, 0};
+    if (!data.weights.empty())
+      quantize_weights(data.weights[i], weights);
+    memcpy(vertex + PackedWeightsOffset, weights, sizeof(weights));
+
+    const uvec4 joints = data.weightsIndex.empty() ? uvec4(0) : data.weightsIndex[i];
+    for (int k = 0; k < 4; k++)
+    {
+      if (result.shortJoints)
+      {
+        const uint16_t joint = joints[k];
+        memcpy(vertex + PackedJointsOffset + k * 2, &joint, sizeof(joint));
+      }
+      else
+        vertex[PackedJointsOffset + k] = (uint8_t)joints[k];
+    }
+  }
+  return result;
+}
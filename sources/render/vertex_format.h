@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "mesh.h"
+
+// Interleaved skinned vertex as uploaded for MeshData meshes:
+//   float3 position, snorm16x2 octahedral normal, half2 uv, unorm8x4 weights, uint8x4 or uint16x4 joint indices.
+// That is 28 or 32 bytes instead of 64 with separate float channels.
+constexpr int PackedPositionOffset = 0;
+constexpr int PackedNormalOffset = 12;
+constexpr int PackedUVOffset = 16;
+constexpr int PackedWeightsOffset = 20;
+constexpr int PackedJointsOffset = 24;
+
+struct PackedVertices
+{
+  std::vector<uint8_t> bytes;
+  int stride = 0;
+  // joint indices don't fit in 8 bits
+  bool shortJoints = false;
+};
+
+PackedVertices pack_vertices(const MeshData &data);
+
+// Octahedral normal encoding (Cigolle et al. 2014), shaders/character_vs.glsl has the decode.
+void encode_octahedral(const vec3 &normal, int16_t result[2]);
+
+// Quantizes weights so they still sum to exactly 255.
+void quantize_weights(const vec4 &weights, uint8_t result[4]);
@@ -18,7 +18,7 @@ layout(std140, binding = 0) readonly buffer InstanceBones
 
 
 layout(location = 0) in vec3 Position;
-layout(location = 1) in vec3 Normal;
+layout(location = 1) in vec2 OctNormal;
 layout(location = 2) in vec2 UV;
 layout(location = 3) in vec4 BoneWeights;
 layout(location = 4) in uvec4 BoneIndex;
@@ -37,8 +37,18 @@ vec3 get_random_color(uint x)
   return fract(col);
 }
 
+// Normals are octahedral encoded snorm16 pairs, see render/vertex_format.h.
+vec3 decode_octahedral(vec2 p)
+{
+  vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+  if (n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  return normalize(n);
+}
+
 void main()
 {
+  vec3 Normal = decode_octahedral(OctNormal);
   mat4 BoneTransform = mat4(0);
 
   for (int  i = 0; i < 4; i++)